@@ -0,0 +1,218 @@
+/*
+ * Measure the memory cost of read results: for each read method and size,
+ * consume many records of that size from a loopback connection and report
+ * bytes allocated on the V8 heap and externally (native buffers) per read
+ * actually issued (one readRecords() call covers many records, scalar reads
+ * take several per record), garbage collections and their pause time, the
+ * peak RSS and external memory, and RSS sampled over the run.
+ *
+ *     node bench/alloc.js [--reads <count>] [--sizes 16,4096] [--no-pool]
+ *                         [--rss-interval <ms>]
+ *
+ * readUInt32 consumes a record with size / 4 scalar reads, so it is skipped
+ * for sizes that are not a multiple of 4.
+ *
+ * With --no-pool, small results get their own buffer instead of sharing a
+ * slab (see posixRead.setSmallResultPool()).
+ *
+ * Allocation per read is measured over batches of reads during which no
+ * garbage collection happened, so that it is not hidden by what was freed.
+ */
+
+const net = require('net');
+const perfHooks = require('perf_hooks');
+
+const posixRead = require('../index');
+
+function getOption(name, defaultValue) {
+    const i = process.argv.indexOf(name);
+    return i === -1 ? defaultValue : process.argv[i + 1];
+}
+
+const reads = parseInt(getOption('--reads', '200000'), 10);
+const sizes = getOption('--sizes', '16,256,4096').split(',')
+              .map((size) => parseInt(size, 10));
+const rssInterval = parseInt(getOption('--rss-interval', '100'), 10);
+const BATCH = 1000;
+
+if (!(reads > 0) || !(rssInterval > 0) ||
+    sizes.some((size) => !(size > 0))) {
+    process.stderr.write('alloc.js: --reads, --sizes and --rss-interval ' +
+                         'must be positive integers\n');
+    process.exit(1);
+}
+
+if (process.argv.indexOf('--no-pool') !== -1)
+    posixRead.setSmallResultPool({ maxSize: 0 });
+
+/*
+ * Read methods to compare. Each one is given a socket, a size and a count of
+ * records to consume, and calls back with the number of reads it issued.
+ */
+const methods = {
+    posixRead(socket, size, count, callback) {
+        let done = 0;
+        (function next() {
+            if (done === count)
+                return callback(count);
+            posixRead(socket, size, (err) => {
+                if (err)
+                    throw err;
+                done++;
+                next();
+            });
+        })();
+    },
+    readRecords(socket, size, count, callback) {
+        posixRead.readRecords(socket, size, count, (err, records) => {
+            if (err)
+                throw err;
+            if (records.length < count) {
+                return methods.readRecords(
+                    socket, size, count - records.length,
+                    (issued) => callback(issued + 1));
+            }
+            callback(1);
+        });
+    },
+    readUInt32(socket, size, count, callback) {
+        // Scalar reads don't allocate a buffer: consume the same bytes
+        let done = 0;
+        const perRead = size / 4;
+        (function next() {
+            if (done === count * perRead)
+                return callback(done);
+            posixRead.readUInt32(socket, 'LE', (err) => {
+                if (err)
+                    throw err;
+                done++;
+                next();
+            });
+        })();
+    },
+};
+
+let gcCount = 0;
+let gcPause = 0;
+const observer = new perfHooks.PerformanceObserver((list) => {
+    list.getEntries().forEach((entry) => {
+        gcCount++;
+        gcPause += entry.duration;
+    });
+});
+observer.observe({ entryTypes: ['gc'] });
+
+function getSocketPair(callback) {
+    const otherEnd = new net.Socket();
+    const server = net.createServer({ pauseOnConnect: true }, (socket) => {
+        server.close();
+        callback(socket, otherEnd);
+    });
+    server.listen(0, () => otherEnd.connect(server.address().port));
+}
+
+/*
+ * Keep the other end writing zeros until `total` bytes are sent.
+ */
+function feed(otherEnd, total) {
+    const chunk = new Buffer(65536).fill(0);
+    let sent = 0;
+    (function write() {
+        while (sent < total) {
+            const size = Math.min(chunk.length, total - sent);
+            sent += size;
+            if (!otherEnd.write(size === chunk.length ? chunk
+                                                      : chunk.slice(0, size)))
+                return otherEnd.once('drain', write);
+        }
+    })();
+}
+
+function run(name, size, callback) {
+    getSocketPair((socket, otherEnd) => {
+        feed(otherEnd, reads * size);
+
+        const start = process.memoryUsage();
+        const gcStart = { count: gcCount, pause: gcPause };
+        const peak = { rss: start.rss, external: start.external };
+        const allocated = { heap: 0, external: 0, reads: 0 };
+        const rss = [start.rss];
+        const sampler = setInterval(() => rss.push(process.memoryUsage().rss),
+                                    rssInterval);
+        const t0 = process.hrtime();
+        let done = 0;
+        let issued = 0;
+
+        (function batch() {
+            if (done === reads) {
+                const elapsed = process.hrtime(t0);
+                const ms = elapsed[0] * 1e3 + elapsed[1] / 1e6;
+                clearInterval(sampler);
+                rss.push(process.memoryUsage().rss);
+                socket.destroy();
+                otherEnd.destroy();
+                const perRead = (bytes) => (allocated.reads ?
+                    (bytes / allocated.reads).toFixed(1) : 'n/a');
+                process.stdout.write(
+                    `${name} (${size} bytes): ` +
+                    `${(reads / ms).toFixed(1)} records/ms, ` +
+                    `${(issued / ms).toFixed(1)} reads/ms, ` +
+                    `heap ${perRead(allocated.heap)} B/read, ` +
+                    `external ${perRead(allocated.external)} B/read, ` +
+                    `${gcCount - gcStart.count} GCs ` +
+                    `(${(gcPause - gcStart.pause).toFixed(1)} ms), ` +
+                    `peak RSS ${(peak.rss / 1048576).toFixed(1)} MiB, ` +
+                    `peak external ` +
+                    `${(peak.external / 1048576).toFixed(1)} MiB\n` +
+                    `  RSS every ${rssInterval} ms (MiB): ` +
+                    rss.map((bytes) => (bytes / 1048576).toFixed(1))
+                       .join(' ') + '\n');
+                return callback();
+            }
+
+            const count = Math.min(BATCH, reads - done);
+            const before = process.memoryUsage();
+            const gcBefore = gcCount;
+            methods[name](socket, size, count, (batchReads) => {
+                const after = process.memoryUsage();
+                issued += batchReads;
+                // GC entries are delivered asynchronously: also skip the
+                // batch if one shows up right after it.
+                setImmediate(() => {
+                    if (gcCount === gcBefore &&
+                        after.heapUsed >= before.heapUsed) {
+                        allocated.heap += after.heapUsed - before.heapUsed;
+                        allocated.external += Math.max(0,
+                            after.external - before.external);
+                        allocated.reads += batchReads;
+                    }
+                    peak.rss = Math.max(peak.rss, after.rss);
+                    peak.external = Math.max(peak.external, after.external);
+                    done += count;
+                    batch();
+                });
+            });
+        })();
+    });
+}
+
+const runs = [];
+Object.keys(methods).forEach((name) => {
+    sizes.forEach((size) => {
+        if (name === 'readUInt32' && size % 4 !== 0) {
+            process.stdout.write(`${name} (${size} bytes): skipped, ` +
+                                 'size is not a multiple of 4\n');
+            return;
+        }
+        runs.push([name, size]);
+    });
+});
+
+(function next() {
+    const r = runs.shift();
+    if (!r) {
+        observer.disconnect();
+        return;
+    }
+    run(r[0], r[1], next);
+})();
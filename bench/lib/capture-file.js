@@ -0,0 +1,92 @@
+const fs = require('fs');
+
+/*
+ * Reading and writing of capture files, as produced by
+ * posixRead.startCapture() or bench/record.js: the magic 'PRCAPv1\n' followed
+ * by records made of a 16-byte header (timestamp in nanoseconds as a 64-bit
+ * integer, connection id as a 32-bit integer, size as a 32-bit integer, all
+ * little-endian) and the data. bench/record.js sets the top bit of the
+ * connection to leave the data out, when only sizes and timing are kept.
+ */
+
+const MAGIC = 'PRCAPv1\n';
+const HEADER_SIZE = 16;
+const NO_DATA = 0x80000000;
+
+function encodeHeader(timestampNs, connection, size) {
+    const header = new Buffer(HEADER_SIZE);
+    // Split the 64-bit timestamp to stay exact without BigInt
+    header.writeUInt32LE(timestampNs % 0x100000000, 0);
+    header.writeUInt32LE(Math.floor(timestampNs / 0x100000000), 4);
+    header.writeUInt32LE(connection, 8);
+    header.writeUInt32LE(size, 12);
+    return header;
+}
+
+/*
+ * Return the records of a capture file grouped by connection, as
+ * `{ <connection>: [{ time, size }] }`, `time` being in milliseconds from the
+ * first record of the file.
+ */
+function load(path) {
+    const file = fs.readFileSync(path);
+    if (file.toString('ascii', 0, MAGIC.length) !== MAGIC)
+        throw new Error(`${path} is not a capture file`);
+
+    const connections = {};
+    let start = null;
+    let offset = MAGIC.length;
+    while (offset + HEADER_SIZE <= file.length) {
+        const timestampNs = file.readUInt32LE(offset) +
+                            file.readUInt32LE(offset + 4) * 0x100000000;
+        const connection = file.readUInt32LE(offset + 8);
+        const size = file.readUInt32LE(offset + 12);
+        offset += HEADER_SIZE;
+        if (!(connection & NO_DATA))
+            offset += size;
+        if (offset > file.length)
+            break;  // truncated last record
+
+        if (start === null)
+            start = timestampNs;
+        const id = connection & ~NO_DATA;
+        if (!connections[id])
+            connections[id] = [];
+        connections[id].push({
+            time: (timestampNs - start) / 1e6,
+            size,
+        });
+    }
+    return connections;
+}
+
+/*
+ * Open a capture file for writing. Only sizes and timing matter to the
+ * replay, so `write()` can be given a length instead of the data, in which
+ * case the record has no data at all. Writes are asynchronous and queued in
+ * order; `close(callback)` calls back once they are all done.
+ */
+function create(path) {
+    const stream = fs.createWriteStream(path);
+    stream.write(new Buffer(MAGIC, 'ascii'));
+
+    return {
+        write(connection, data) {
+            const hrtime = process.hrtime();
+            const timestampNs = hrtime[0] * 1e9 + hrtime[1];
+            if (typeof data === 'number') {
+                stream.write(encodeHeader(timestampNs,
+                                          (connection | NO_DATA) >>> 0, data));
+                return;
+            }
+            stream.write(encodeHeader(timestampNs, connection, data.length));
+            stream.write(data);
+        },
+        close(callback) {
+            stream.end(callback);
+        },
+    };
+}
+
+module.exports.load = load;
+module.exports.create = create;
@@ -0,0 +1,457 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Hardware-counter microbenchmarks of the native read paths, without V8: each
+ * case runs a code path many times and reports cycles, instructions, cache
+ * misses and context switches per operation and, for cases that move or
+ * process data, per byte, as counted by perf_event_open(2). Besides the
+ * syscall paths, post-processing cases (frame and delimiter scans, a digest,
+ * LZ4 and AEAD) show what a read costs once the data is in.
+ *
+ *     ./read-loop [iterations]
+ *
+ * If perf events are not allowed (see /proc/sys/kernel/perf_event_paranoid),
+ * only the elapsed time is reported.
+ */
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+
+#include <vector>
+
+#include "../../src/cpp/aead.h"
+#include "../../src/cpp/frames.h"
+#include "../../src/cpp/io.h"
+#include "../../src/cpp/lz4.h"
+
+enum { COUNTER_CYCLES, COUNTER_INSTRUCTIONS, COUNTER_CACHE_MISSES,
+       COUNTER_CONTEXT_SWITCHES, COUNTER_COUNT };
+
+static const char *counter_names[COUNTER_COUNT] = {
+    "cycles", "instr", "cache-miss", "ctx-sw",
+};
+
+struct Counters {
+    int fds[COUNTER_COUNT];
+    uint64_t values[COUNTER_COUNT];
+    struct timespec start;
+    double elapsed_ns;
+};
+
+static int OpenCounter(uint32_t type, uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    // Count this thread only, on any CPU
+    return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/*
+ * Open the counters as one group, so that they are scheduled together. Those
+ * that can't be opened (e.g. no hardware PMU in a VM) read as zero.
+ */
+static void OpenCounters(Counters *counters) {
+    static const uint32_t types[COUNTER_COUNT] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_SOFTWARE,
+    };
+    static const uint64_t configs[COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_SW_CONTEXT_SWITCHES,
+    };
+
+    int leader = -1;
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        counters->fds[i] = OpenCounter(types[i], configs[i], leader);
+        if (leader == -1)
+            leader = counters->fds[i];
+    }
+}
+
+static int Leader(const Counters &counters) {
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        if (counters.fds[i] != -1)
+            return counters.fds[i];
+    return -1;
+}
+
+static void StartCounters(Counters *counters) {
+    int leader = Leader(*counters);
+    if (leader != -1) {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &counters->start);
+}
+
+static void StopCounters(Counters *counters) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    counters->elapsed_ns = (end.tv_sec - counters->start.tv_sec) * 1e9 +
+                           (end.tv_nsec - counters->start.tv_nsec);
+
+    memset(counters->values, 0, sizeof(counters->values));
+    int leader = Leader(*counters);
+    if (leader == -1)
+        return;
+    ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // With PERF_FORMAT_GROUP: the number of events, then their values in
+    // the order they were added to the group.
+    uint64_t buffer[1 + COUNTER_COUNT];
+    if (read(leader, buffer, sizeof(buffer)) < (ssize_t) sizeof(uint64_t))
+        return;
+    size_t n = 0;
+    for (int i = 0; i < COUNTER_COUNT; i++)
+        if (counters->fds[i] != -1 && n < buffer[0])
+            counters->values[i] = buffer[1 + n++];
+}
+
+static void Report(const char *name, const Counters &counters, size_t ops,
+                   size_t bytes_per_op) {
+    printf("%-16s %9.1f ns/op", name, counters.elapsed_ns / ops);
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        if (counters.fds[i] == -1)
+            printf("  %s n/a", counter_names[i]);
+        else
+            printf("  %s %.1f/op", counter_names[i],
+                   (double) counters.values[i] / ops);
+    }
+    if (bytes_per_op) {
+        printf("  |  %.3f ns/B", counters.elapsed_ns / ops / bytes_per_op);
+        for (int i = 0; i < COUNTER_COUNT; i++)
+            if (counters.fds[i] != -1)
+                printf("  %s %.4f/B", counter_names[i],
+                       (double) counters.values[i] / ops / bytes_per_op);
+    }
+    printf("\n");
+}
+
+/*
+ * Other end of the socket pair, writing `total` bytes in segments of
+ * `segment` bytes.
+ */
+struct Writer {
+    int fd;
+    size_t total;
+    size_t segment;
+};
+
+static void *WriterThread(void *arg) {
+    Writer *writer = reinterpret_cast<Writer *>(arg);
+    std::vector<char> data(writer->segment, 'x');
+    for (size_t sent = 0; sent < writer->total; ) {
+        size_t size = writer->total - sent < writer->segment ?
+                      writer->total - sent : writer->segment;
+        ssize_t n = write(writer->fd, &data[0], size);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        sent += n;
+    }
+    return NULL;
+}
+
+typedef ssize_t (*ReadFunction)(int fd, char *data, size_t size);
+
+static ssize_t ReadVectored(int fd, char *data, size_t size) {
+    // Four iovecs, as for a read scattered to several destinations
+    struct iovec iov[4];
+    size_t quarter = size / 4;
+    for (int i = 0; i < 4; i++) {
+        iov[i].iov_base = data + i * quarter;
+        iov[i].iov_len = i == 3 ? size - 3 * quarter : quarter;
+    }
+    size_t count = 0;
+    int first = 0;
+    while (count < size) {
+        ssize_t n = readv(fd, &iov[first], 4 - first);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        } else if (n == 0) {
+            break;
+        }
+        count += n;
+        while (first < 4 && (size_t) n >= iov[first].iov_len) {
+            n -= iov[first].iov_len;
+            first++;
+        }
+        if (first < 4) {
+            iov[first].iov_base = (char *) iov[first].iov_base + n;
+            iov[first].iov_len -= n;
+        }
+    }
+    return count;
+}
+
+/*
+ * Consume `iterations` reads of `size` bytes, arriving in segments of
+ * `segment` bytes: when the segment is smaller than the read, ReadExactly()
+ * loops on short reads.
+ */
+static void BenchRead(const char *name, Counters *counters, ReadFunction fn,
+                      size_t iterations, size_t size, size_t segment) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+        perror("socketpair");
+        exit(1);
+    }
+
+    Writer writer = { fds[1], iterations * size, segment };
+    pthread_t thread;
+    pthread_create(&thread, NULL, WriterThread, &writer);
+
+    std::vector<char> data(size);
+    StartCounters(counters);
+    for (size_t i = 0; i < iterations; i++) {
+        if (fn(fds[0], &data[0], size) != (ssize_t) size) {
+            fprintf(stderr, "%s: short read\n", name);
+            exit(1);
+        }
+    }
+    StopCounters(counters);
+    Report(name, *counters, iterations, size);
+
+    pthread_join(thread, NULL);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void BenchBlockingToggle(Counters *counters, size_t iterations) {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+
+    StartCounters(counters);
+    for (size_t i = 0; i < iterations; i++) {
+        bool was_non_blocking;
+        SetBlocking(fds[0], &was_non_blocking);
+        UnsetBlocking(fds[0], was_non_blocking);
+    }
+    StopCounters(counters);
+    Report("blocking-toggle", *counters, iterations, 0);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void BenchPeek(Counters *counters, size_t iterations, size_t size) {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    std::vector<char> data(size, 'x');
+    if (write(fds[1], &data[0], size) != (ssize_t) size) {
+        perror("write");
+        exit(1);
+    }
+
+    StartCounters(counters);
+    for (size_t i = 0; i < iterations; i++)
+        PeekExactly(fds[0], &data[0], size);
+    StopCounters(counters);
+    Report("peek", *counters, iterations, size);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void BenchScanFrames(Counters *counters, size_t iterations) {
+    // 1024 frames of 60 bytes with a 4-byte big-endian prefix
+    const size_t frame_count = 1024, payload = 60;
+    std::vector<char> data(frame_count * (4 + payload), 0);
+    for (size_t i = 0; i < frame_count; i++)
+        data[i * (4 + payload) + 3] = payload;
+    PrefixSpec prefix = { 4, true };
+    std::vector<FrameSpan> frames;
+    frames.reserve(frame_count);
+
+    StartCounters(counters);
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t next_size;
+        frames.clear();
+        ScanFrames(prefix, &data[0], data.size(), frame_count, &frames,
+                   &next_size);
+    }
+    StopCounters(counters);
+    Report("scan-frames", *counters, iterations, data.size());
+}
+
+/*
+ * Post-processing of a read: find the line boundaries in a buffer of
+ * 64-byte lines, as a delimiter-based protocol would.
+ */
+static void BenchScanDelimiter(Counters *counters, size_t iterations,
+                               size_t size) {
+    std::vector<char> data(size, 'x');
+    for (size_t i = 63; i < size; i += 64)
+        data[i] = '\n';
+
+    size_t lines = 0;
+    StartCounters(counters);
+    for (size_t i = 0; i < iterations; i++) {
+        const char *p = &data[0], *end = &data[0] + size;
+        while ((p = (const char *) memchr(p, '\n', end - p)) != NULL) {
+            lines++;
+            p++;
+        }
+    }
+    StopCounters(counters);
+    if (lines != iterations * (size / 64)) {
+        fprintf(stderr, "scan-delimiter: found %zu lines\n", lines);
+        exit(1);
+    }
+    Report("scan-delimiter", *counters, iterations, size);
+}
+
+/*
+ * Post-processing of a read: a SHA-256 digest of the payload, as for an
+ * integrity check.
+ */
+static void BenchDigest(Counters *counters, size_t iterations, size_t size) {
+    std::vector<char> data(size, 'x');
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length;
+
+    StartCounters(counters);
+    for (size_t i = 0; i < iterations; i++) {
+        if (!EVP_Digest(&data[0], size, digest, &length, EVP_sha256(),
+                        NULL)) {
+            fprintf(stderr, "digest: EVP_Digest failed\n");
+            exit(1);
+        }
+    }
+    StopCounters(counters);
+    Report("digest-sha256", *counters, iterations, size);
+}
+
+static void BenchLz4(Counters *counters, size_t iterations) {
+    // 'abcd', then a 65536-byte match repeating it, then 5 final literals
+    const size_t match = 65536;
+    std::vector<char> block;
+    block.push_back((char) 0x4f);
+    block.insert(block.end(), "abcd", "abcd" + 4);
+    block.push_back(4);
+    block.push_back(0);
+    for (size_t left = match - 4 - 15; ; left -= 255) {
+        block.push_back((char) (left < 255 ? left : 255));
+        if (left < 255)
+            break;
+    }
+    block.push_back((char) 0x50);
+    block.insert(block.end(), "efghi", "efghi" + 5);
+    std::vector<char> out(4 + match + 5);
+
+    StartCounters(counters);
+    for (size_t i = 0; i < iterations; i++) {
+        if (Lz4DecompressBlock(&block[0], block.size(), &out[0], out.size())
+                != (ssize_t) out.size()) {
+            fprintf(stderr, "lz4: bad block\n");
+            exit(1);
+        }
+    }
+    StopCounters(counters);
+    Report("lz4", *counters, iterations, out.size());
+}
+
+static void BenchAead(Counters *counters, size_t iterations, size_t size) {
+    AeadKey key;
+    key.algorithm = AEAD_AES_256_GCM;
+    memset(key.key, 7, sizeof(key.key));
+    if (!AeadAlgorithmSupported(key.algorithm)) {
+        printf("aead             not supported\n");
+        return;
+    }
+
+    // nonce + ciphertext + tag, as expected by AeadDecrypt()
+    std::vector<char> sealed(AEAD_NONCE_SIZE + size + AEAD_TAG_SIZE, 0);
+    unsigned char *nonce = reinterpret_cast<unsigned char *>(&sealed[0]);
+    unsigned char *text = nonce + AEAD_NONCE_SIZE;
+    int length;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, key.key, nonce);
+    EVP_EncryptUpdate(ctx, text, &length, text, size);
+    EVP_EncryptFinal_ex(ctx, text + length, &length);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AEAD_TAG_SIZE,
+                        text + size);
+    EVP_CIPHER_CTX_free(ctx);
+
+    // Decryption is in place: each iteration works on a fresh copy, which
+    // is included in the counts.
+    std::vector<char> data(sealed.size());
+    StartCounters(counters);
+    for (size_t i = 0; i < iterations; i++) {
+        memcpy(&data[0], &sealed[0], sealed.size());
+        if (AeadDecrypt(key, NULL, 0, &data[0], data.size()) == -1) {
+            fprintf(stderr, "aead: authentication failed\n");
+            exit(1);
+        }
+    }
+    StopCounters(counters);
+    Report("aead-aes256gcm", *counters, iterations, size);
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+
+    Counters counters;
+    OpenCounters(&counters);
+    if (Leader(counters) == -1)
+        fprintf(stderr, "perf_event_open: %s, reporting time only\n",
+                strerror(errno));
+
+    BenchBlockingToggle(&counters, iterations);
+    BenchRead("read-64", &counters, ReadExactly, iterations, 64, 64);
+    BenchRead("read-4096", &counters, ReadExactly, iterations, 4096, 4096);
+    BenchRead("read-short-loop", &counters, ReadExactly, iterations / 10,
+              4096, 256);
+    BenchRead("readv-4096", &counters, ReadVectored, iterations, 4096, 4096);
+    BenchPeek(&counters, iterations, 4096);
+    BenchScanFrames(&counters, iterations / 100);
+    BenchScanDelimiter(&counters, iterations / 10, 4096);
+    BenchDigest(&counters, iterations / 10, 4096);
+    BenchLz4(&counters, iterations / 100);
+    BenchAead(&counters, iterations / 10, 4096);
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * Record the traffic shape of real clients: listen on a local port, forward
+ * every connection to an upstream server, and write the arrival time and size
+ * of each segment received from clients to a capture file.
+ *
+ *     node bench/record.js <capture file> <listen port> <upstream host:port>
+ *         [--with-data]
+ *
+ * Without --with-data, only sizes and timing are recorded (that is all
+ * bench/replay.js needs, it generates the payloads). Stop with Ctrl-C.
+ */
+
+const net = require('net');
+
+const captureFile = require('./lib/capture-file');
+
+const args = process.argv.slice(2).filter((arg) => arg[0] !== '-');
+const withData = process.argv.indexOf('--with-data') !== -1;
+if (args.length !== 3) {
+    process.stderr.write('usage: node bench/record.js <capture file> ' +
+                         '<listen port> <upstream host:port> ' +
+                         '[--with-data]\n');
+    process.exit(1);
+}
+
+const capture = captureFile.create(args[0]);
+const upstream = args[2].split(':');
+let connections = 0;
+let segments = 0;
+
+const server = net.createServer((client) => {
+    const connection = connections++;
+    const peer = net.connect(parseInt(upstream[1], 10), upstream[0]);
+
+    client.on('data', (data) => {
+        capture.write(connection, withData ? data : data.length);
+        segments++;
+    });
+    client.pipe(peer).pipe(client);
+    client.on('error', () => peer.destroy());
+    peer.on('error', () => client.destroy());
+});
+
+server.listen(parseInt(args[1], 10));
+
+process.on('SIGINT', () => {
+    server.close();
+    capture.close(() => {
+        process.stderr.write(`recorded ${segments} segments from ` +
+                             `${connections} connections\n`);
+        process.exit(0);
+    });
+});
@@ -0,0 +1,162 @@
+/*
+ * Replay the traffic shape of a capture file against posix-read: for each
+ * recorded connection, a writer sends segments of the recorded sizes at the
+ * recorded times, while a reader consumes them with posixRead(), one read per
+ * segment. Throughput, read latency (from the write of a segment to the
+ * completion of its read) and threadpool occupancy are reported.
+ *
+ *     node bench/replay.js <capture file> [--unix] [--speed <factor>]
+ *
+ * Connections go over loopback TCP, or Unix sockets with --unix. --speed 2
+ * replays twice as fast, --speed 0 sends everything as fast as possible.
+ *
+ * Captures from posixRead.startCapture() time each segment when the recorded
+ * application read it, not when it arrived: replayed timings then follow that
+ * reader's pace. bench/record.js timestamps arrivals.
+ */
+
+const fs = require('fs');
+const net = require('net');
+const os = require('os');
+const path = require('path');
+
+const posixRead = require('../index');
+const captureFile = require('./lib/capture-file');
+
+function getOption(name, defaultValue) {
+    const i = process.argv.indexOf(name);
+    return i === -1 ? defaultValue : process.argv[i + 1];
+}
+
+const file = process.argv[2];
+if (!file || file[0] === '-') {
+    process.stderr.write('usage: node bench/replay.js <capture file> ' +
+                         '[--unix] [--speed <factor>]\n');
+    process.exit(1);
+}
+const unix = process.argv.indexOf('--unix') !== -1;
+const speed = parseFloat(getOption('--speed', '1'));
+const threadpoolSize = parseInt(process.env.UV_THREADPOOL_SIZE || '4', 10);
+
+const connections = captureFile.load(file);
+const latencies = [];
+let totalBytes = 0;
+
+// Time-weighted count of reads in flight, to estimate threadpool occupancy
+let inFlight = 0;
+let inFlightSince = process.hrtime();
+let busyTime = 0;
+
+function now() {
+    const t = process.hrtime();
+    return t[0] * 1e3 + t[1] / 1e6;
+}
+
+function setInFlight(delta) {
+    const elapsed = process.hrtime(inFlightSince);
+    busyTime += Math.min(inFlight, threadpoolSize) *
+                (elapsed[0] * 1e3 + elapsed[1] / 1e6);
+    inFlightSince = process.hrtime();
+    inFlight += delta;
+}
+
+/*
+ * Create a pair of connected sockets, the first one paused for posix-read.
+ */
+function getSocketPair(id, callback) {
+    const otherEnd = new net.Socket();
+    const address = unix ? path.join(os.tmpdir(),
+                                     `posix-read-bench-${process.pid}-${id}`)
+                         : 0;
+
+    const server = net.createServer({ pauseOnConnect: true }, (socket) => {
+        server.close();
+        callback(socket, otherEnd);
+    });
+    server.listen(address, () => {
+        otherEnd.connect(unix ? address : server.address().port);
+    });
+}
+
+function replayConnection(id, segments, callback) {
+    getSocketPair(id, (socket, otherEnd) => {
+        const sentAt = [];
+        const start = now();
+
+        segments.forEach((segment, i) => {
+            setTimeout(() => {
+                sentAt[i] = now();
+                otherEnd.write(new Buffer(segment.size).fill(0));
+            }, speed > 0 ? segment.time / speed : 0);
+        });
+
+        function readNext(i) {
+            if (i === segments.length) {
+                otherEnd.destroy();
+                socket.destroy();
+                return callback(now() - start);
+            }
+
+            setInFlight(1);
+            posixRead(socket, segments[i].size, (err, buffer) => {
+                setInFlight(-1);
+                if (err)
+                    throw err;
+                latencies.push(now() - sentAt[i]);
+                totalBytes += buffer.length;
+                readNext(i + 1);
+            });
+        }
+        readNext(0);
+    });
+}
+
+function percentile(sorted, p) {
+    return sorted[Math.min(sorted.length - 1,
+                           Math.floor(sorted.length * p))];
+}
+
+const ids = Object.keys(connections);
+if (ids.length === 0) {
+    process.stderr.write(`${file} contains no records\n`);
+    process.exit(1);
+}
+const start = now();
+let remaining = ids.length;
+
+ids.forEach((id) => {
+    replayConnection(id, connections[id], () => {
+        if (--remaining > 0)
+            return;
+
+        setInFlight(0);
+        const elapsed = now() - start;
+        latencies.sort((a, b) => a - b);
+        process.stdout.write(
+            `connections: ${ids.length}, reads: ${latencies.length}, ` +
+            `bytes: ${totalBytes}\n` +
+            `elapsed: ${elapsed.toFixed(1)} ms, throughput: ` +
+            `${(totalBytes / elapsed / 1e3).toFixed(2)} MB/s\n` +
+            `latency (ms): p50 ${percentile(latencies, 0.5).toFixed(3)}, ` +
+            `p99 ${percentile(latencies, 0.99).toFixed(3)}, ` +
+            `p99.9 ${percentile(latencies, 0.999).toFixed(3)}, ` +
+            `max ${latencies[latencies.length - 1].toFixed(3)}\n` +
+            `threadpool occupancy: ` +
+            `${(100 * busyTime / elapsed / threadpoolSize).toFixed(1)}% ` +
+            `of ${threadpoolSize} threads\n`);
+    });
+});
+
+if (unix) {
+    process.on('exit', () => {
+        ids.forEach((id) => {
+            const address = path.join(os.tmpdir(),
+                                      `posix-read-bench-${process.pid}-${id}`);
+            try {
+                fs.unlinkSync(address);
+            } catch (err) {
+                // already removed by server.close()
+            }
+        });
+    });
+}
@@ -2,7 +2,41 @@
     "targets": [
         {
             "target_name": "posix-read",
-            "sources": [ "src/cpp/posix-read.cpp", "src/cpp/module.cpp" ],
+            "sources": [
+                "src/cpp/accounting.cpp",
+                "src/cpp/aead.cpp",
+                "src/cpp/capture.cpp",
+                "src/cpp/capture-methods.cpp",
+                "src/cpp/chunked.cpp",
+                "src/cpp/common.cpp",
+                "src/cpp/frames.cpp",
+                "src/cpp/io.cpp",
+                "src/cpp/ktls.cpp",
+                "src/cpp/ktls-methods.cpp",
+                "src/cpp/lz4.cpp",
+                "src/cpp/read-worker.cpp",
+                "src/cpp/posix-read.cpp",
+                "src/cpp/read-ranges.cpp",
+                "src/cpp/prefetch.cpp",
+                "src/cpp/read-records.cpp",
+                "src/cpp/read-scalar.cpp",
+                "src/cpp/on-readable.cpp",
+                "src/cpp/read-frames.cpp",
+                "src/cpp/read-frame.cpp",
+                "src/cpp/listener.cpp",
+                "src/cpp/read-any.cpp",
+                "src/cpp/read-chunked.cpp",
+                "src/cpp/read-websocket-frame.cpp",
+                "src/cpp/read-messages.cpp",
+                "src/cpp/reader-pool.cpp",
+                "src/cpp/transform-pool.cpp",
+                "src/cpp/accounting-methods.cpp",
+                "src/cpp/websocket.cpp",
+                "src/cpp/rate-limit.cpp",
+                "src/cpp/memory-pressure.cpp",
+                "src/cpp/slab.cpp",
+                "src/cpp/module.cpp"
+            ],
             "include_dirs" : [
                 "<!(node -e \"require('nan')\")"
             ],
@@ -1 +1,139 @@
-module.exports = require('bindings')('posix-read').Read;
+const crypto = require('crypto');
+const net = require('net');
+
+const binding = require('bindings')('posix-read');
+
+/*
+ * Native per-socket state (rate limits, groups, heavy hitter tags) is keyed by
+ * file descriptor: drop it right before the descriptor is closed, so that the
+ * next socket to get the same descriptor doesn't inherit it.
+ */
+function forgetOnClose(socket) {
+    const handle = socket._handle;
+    if (!handle || handle.posixReadForget)
+        return;
+
+    const fd = handle.fd;
+    const close = handle.close;
+    handle.posixReadForget = true;
+    handle.close = function closeAndForget() {
+        binding.ForgetFd(fd);
+        return close.apply(this, arguments);
+    };
+}
+
+module.exports = binding.Read;
+module.exports.readRanges = binding.ReadRanges;
+module.exports.prefetch = binding.Prefetch;
+module.exports.readRecords = binding.ReadRecords;
+module.exports.readUInt8 = binding.ReadUInt8;
+module.exports.readUInt16 = binding.ReadUInt16;
+module.exports.readUInt32 = binding.ReadUInt32;
+// Only available on Node.js versions with BigInt support
+module.exports.readBigUInt64 = binding.ReadBigUInt64;
+module.exports.onReadable = binding.OnReadable;
+module.exports.setFastErrors = binding.SetFastErrors;
+module.exports.readFrames = binding.ReadFrames;
+module.exports.readFrame = binding.ReadFrame;
+module.exports.startCapture = binding.StartCapture;
+module.exports.stopCapture = binding.StopCapture;
+module.exports.captureStats = binding.CaptureStats;
+module.exports.readAny = binding.ReadAny;
+module.exports.readChunked = binding.ReadChunked;
+module.exports.readWebSocketFrame = binding.ReadWebSocketFrame;
+module.exports.setRateLimit = function setRateLimit(target, limits) {
+    binding.SetRateLimit(target, limits);
+    if (typeof target !== 'string')
+        forgetOnClose(target);
+};
+module.exports.setRateLimitGroup = function setRateLimitGroup(socket,
+                                                              group) {
+    binding.SetRateLimitGroup(socket, group);
+    forgetOnClose(socket);
+};
+module.exports.rateLimitStats = binding.RateLimitStats;
+module.exports.watchMemoryPressure = binding.WatchMemoryPressure;
+module.exports.unwatchMemoryPressure = binding.UnwatchMemoryPressure;
+module.exports.memoryPressureStats = binding.MemoryPressureStats;
+module.exports.simulateMemoryPressure = binding.SimulateMemoryPressure;
+module.exports.setSmallResultPool = binding.SetSmallResultPool;
+module.exports.enableKtlsRx = binding.EnableKtlsRx;
+module.exports.readMessages = binding.ReadMessages;
+module.exports.seqpacketPair = binding.SeqpacketPair;
+module.exports.setReaderPool = binding.SetReaderPool;
+module.exports.readerPoolStats = binding.ReaderPoolStats;
+module.exports.setTransformPool = binding.SetTransformPool;
+module.exports.transformPoolStats = binding.TransformPoolStats;
+module.exports.trackHeavyHitters = binding.TrackHeavyHitters;
+module.exports.setHeavyHitterTag = function setHeavyHitterTag(socket, tag) {
+    binding.SetHeavyHitterTag(socket, tag);
+    forgetOnClose(socket);
+};
+module.exports.heavyHitters = binding.HeavyHitters;
+
+/*
+ * Accept connections natively and, if asked, read their first bytes before
+ * passing them to `onConnection(err, socket, firstBytes)`. Sockets are created
+ * paused, ready for posix-read.
+ */
+module.exports.listen = function listen(options, onConnection) {
+    if (typeof onConnection !== 'function')
+        throw new TypeError('second argument should be a function');
+
+    const listener = binding.Listen(options, (err, fd, firstBytes) => {
+        if (err)
+            return onConnection(err);
+
+        const socket = new net.Socket({
+            fd,
+            readable: true,
+            writable: true,
+            pauseOnCreate: true,
+        });
+        return onConnection(null, socket, firstBytes);
+    });
+
+    return {
+        port: listener.port,
+        close: () => binding.CloseListener(listener.fd),
+    };
+};
+
+/*
+ * HKDF-Expand-Label from TLS 1.3 (RFC 8446, section 7.1), with an empty
+ * context.
+ */
+function hkdfExpandLabel(hash, secret, label, length) {
+    const fullLabel = new Buffer(`tls13 ${label}`, 'ascii');
+    const info = Buffer.concat([
+        new Buffer([length >> 8, length & 0xff, fullLabel.length]),
+        fullLabel,
+        new Buffer([0]),
+    ]);
+
+    const blocks = [];
+    let block = new Buffer(0);
+    for (let i = 1; blocks.length * block.length < length; i++) {
+        block = crypto.createHmac(hash, secret)
+            .update(Buffer.concat([block, info, new Buffer([i])]))
+            .digest();
+        blocks.push(block);
+    }
+    return Buffer.concat(blocks).slice(0, length);
+}
+
+/*
+ * Derive the key and IV to give to enableKtlsRx() from a TLS 1.3 traffic
+ * secret, e.g. CLIENT_TRAFFIC_SECRET_0 from the 'keylog' event of a
+ * tls.TLSSocket.
+ */
+module.exports.ktlsKeysFromSecret = function ktlsKeysFromSecret(cipher,
+                                                                secret) {
+    const hash = cipher === 'aes-256-gcm' ? 'sha384' : 'sha256';
+    const keySize = cipher === 'aes-128-gcm' ? 16 : 32;
+
+    return {
+        key: hkdfExpandLabel(hash, secret, 'key', keySize),
+        iv: hkdfExpandLabel(hash, secret, 'iv', 12),
+    };
+};
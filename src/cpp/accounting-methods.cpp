@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include <nan.h>
+
+#include "accounting.h"
+#include "common.h"
+
+#define MAX_TAG_LENGTH 256
+
+NAN_METHOD(TrackHeavyHitters) {
+    if (info.Length() != 1) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'options' argument, or null to stop tracking.
+     */
+    size_t k = 0;
+    if (!info[0]->IsNull()
+            && (!info[0]->IsObject()
+                || !GetSizeOption(info[0].As<v8::Object>(), "k", 32, &k)
+                || k > 10000)) {
+        Nan::ThrowTypeError("first argument should be an object with valid "
+                            "options, or null");
+        return;
+    }
+
+    HeavyHittersEnable(k);
+}
+
+NAN_METHOD(SetHeavyHitterTag) {
+    if (info.Length() != 2) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' argument.
+     */
+    if (!LooksLikeASocket(info[0])) {
+        Nan::ThrowTypeError("first argument should be a socket");
+        return;
+    }
+    int fd = GetFdFromSocket(info[0].As<v8::Object>());
+    if (fd == -1) {
+        Nan::ThrowTypeError("malformed socket object, cannot get file "
+                            "descriptor");
+        return;
+    }
+
+    /*
+     * Get 'tag' argument.
+     */
+    if (info[1]->IsNull()) {
+        HeavyHittersSetTag(fd, NULL);
+    } else if (info[1]->IsString()
+               && info[1].As<v8::String>()->Length() <= MAX_TAG_LENGTH) {
+        if (!HeavyHittersSetTag(fd, *Nan::Utf8String(info[1])))
+            Nan::ThrowError("cannot tag socket: too many tagged sockets");
+    } else {
+        Nan::ThrowTypeError("second argument should be a tag, or null");
+        return;
+    }
+}
+
+NAN_METHOD(HeavyHitters) {
+    /*
+     * Get 'metric' argument.
+     */
+    if (info.Length() != 1 || !info[0]->IsString()) {
+        Nan::ThrowTypeError("first argument should be 'bytes', 'reads' or "
+                            "'blockedMs'");
+        return;
+    }
+    HitterMetric metric;
+    Nan::Utf8String name(info[0]);
+    if (!strcmp("bytes", *name)) {
+        metric = HITTER_BYTES;
+    } else if (!strcmp("reads", *name)) {
+        metric = HITTER_READS;
+    } else if (!strcmp("blockedMs", *name)) {
+        metric = HITTER_BLOCKED_NS;
+    } else {
+        Nan::ThrowTypeError("first argument should be 'bytes', 'reads' or "
+                            "'blockedMs'");
+        return;
+    }
+    double scale = metric == HITTER_BLOCKED_NS ? 1e-6 : 1;
+
+    std::vector<HeavyHitter> hitters;
+    HeavyHittersGet(metric, &hitters);
+
+    v8::Local<v8::Array> result = Nan::New<v8::Array>(hitters.size());
+    for (size_t i = 0; i < hitters.size(); i++) {
+        v8::Local<v8::Object> hitter = Nan::New<v8::Object>();
+        if (hitters[i].key.fd == -1)
+            hitter->Set(Nan::New<v8::String>("tag").ToLocalChecked(),
+                        Nan::New<v8::String>(hitters[i].key.tag)
+                                .ToLocalChecked());
+        else
+            hitter->Set(Nan::New<v8::String>("fd").ToLocalChecked(),
+                        Nan::New<v8::Number>(hitters[i].key.fd));
+        hitter->Set(Nan::New<v8::String>("value").ToLocalChecked(),
+                    Nan::New<v8::Number>(hitters[i].count * scale));
+        hitter->Set(Nan::New<v8::String>("error").ToLocalChecked(),
+                    Nan::New<v8::Number>(hitters[i].error * scale));
+        result->Set(i, hitter);
+    }
+
+    info.GetReturnValue().Set(result);
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "accounting.h"
+
+/*
+ * Space-saving summary (Metwally et al.): at most `k` counters. A key that is
+ * not tracked replaces the smallest counter and inherits its count, which
+ * becomes its error. Any key whose total is more than 1/k of the grand total
+ * is guaranteed to be tracked.
+ */
+class SpaceSaving {
+ private:
+    size_t k;
+    std::vector<HeavyHitter> counters;
+    std::map<HitterKey, size_t> index;
+
+ public:
+    explicit SpaceSaving(size_t k) : k(k) { }
+
+    void Add(const HitterKey &key, uint64_t weight) {
+        std::map<HitterKey, size_t>::iterator it = index.find(key);
+        if (it != index.end()) {
+            counters[it->second].count += weight;
+            return;
+        }
+
+        if (counters.size() < k) {
+            HeavyHitter counter = { key, weight, 0 };
+            index[key] = counters.size();
+            counters.push_back(counter);
+            return;
+        }
+
+        size_t min = 0;
+        for (size_t i = 1; i < counters.size(); i++)
+            if (counters[i].count < counters[min].count)
+                min = i;
+
+        index.erase(counters[min].key);
+        index[key] = min;
+        counters[min].key = key;
+        counters[min].error = counters[min].count;
+        counters[min].count += weight;
+    }
+
+    const std::vector<HeavyHitter> &Counters() const { return counters; }
+};
+
+static std::atomic<bool> enabled(false);
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static std::map<int, uint64_t> consumed;
+
+static std::atomic<bool> hitters_enabled(false);
+static SpaceSaving *hitters[HITTER_METRICS];
+static std::map<int, std::string> tags;
+
+// Tags are dropped when their socket is closed; this only bounds the table
+// if sockets are tagged and never closed.
+#define MAX_TAGGED_FDS 65536
+
+void AccountingEnable(bool enable) {
+    enabled = enable;
+}
+
+static HitterKey KeyOf(int fd) {
+    HitterKey key = { fd, "" };
+
+    std::map<int, std::string>::iterator it = tags.find(fd);
+    if (it != tags.end()) {
+        key.fd = -1;
+        key.tag = it->second;
+    }
+
+    return key;
+}
+
+/*
+ * Called with `lock` held.
+ */
+static void AddHit(int fd, HitterMetric metric, uint64_t weight) {
+    if (hitters[metric] != NULL)
+        hitters[metric]->Add(KeyOf(fd), weight);
+}
+
+/*
+ * Track the top `k` of each metric, starting from zero, or stop if `k` is 0.
+ */
+void HeavyHittersEnable(size_t k) {
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < HITTER_METRICS; i++) {
+        delete hitters[i];
+        hitters[i] = k ? new SpaceSaving(k) : NULL;
+    }
+    hitters_enabled = k != 0;
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Count the reads of `fd` under `tag` rather than under the fd itself, or
+ * stop if `tag` is NULL. Returns false if too many fds are tagged already.
+ */
+bool HeavyHittersSetTag(int fd, const char *tag) {
+    bool ok = true;
+
+    pthread_mutex_lock(&lock);
+    if (tag == NULL)
+        tags.erase(fd);
+    else if (tags.size() < MAX_TAGGED_FDS || tags.count(fd))
+        tags[fd] = tag;
+    else
+        ok = false;
+    pthread_mutex_unlock(&lock);
+
+    return ok;
+}
+
+/*
+ * Monotonic time in nanoseconds, to pass to AccountBlocked(), or 0 when not
+ * tracking heavy hitters, so that the clock is not read for nothing.
+ */
+uint64_t AccountingClock() {
+    if (!hitters_enabled)
+        return 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+ * Called from the main thread when a read on `fd` is queued.
+ */
+void AccountReadIssued(int fd) {
+    if (!hitters_enabled)
+        return;
+
+    pthread_mutex_lock(&lock);
+    AddHit(fd, HITTER_READS, 1);
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Called by the workers after waiting for data on `fd` since `start`.
+ */
+void AccountBlocked(int fd, uint64_t start) {
+    if (start == 0)
+        return;
+
+    uint64_t now = AccountingClock();
+    if (now <= start)
+        return;
+
+    pthread_mutex_lock(&lock);
+    AddHit(fd, HITTER_BLOCKED_NS, now - start);
+    pthread_mutex_unlock(&lock);
+}
+
+static bool ByCount(const HeavyHitter &a, const HeavyHitter &b) {
+    return a.count > b.count;
+}
+
+/*
+ * The tracked keys for `metric`, largest first.
+ */
+void HeavyHittersGet(HitterMetric metric, std::vector<HeavyHitter> *result) {
+    result->clear();
+
+    pthread_mutex_lock(&lock);
+    if (hitters[metric] != NULL)
+        *result = hitters[metric]->Counters();
+    pthread_mutex_unlock(&lock);
+
+    std::sort(result->begin(), result->end(), ByCount);
+}
+
+/*
+ * Called by the workers after each read(2).
+ */
+void AccountRead(int fd, size_t size) {
+    if (!enabled && !hitters_enabled)
+        return;
+
+    pthread_mutex_lock(&lock);
+    if (enabled)
+        consumed[fd] += size;
+    if (hitters_enabled)
+        AddHit(fd, HITTER_BYTES, size);
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Move the counts collected since the last call to `bytes`.
+ */
+void AccountingDrain(std::map<int, uint64_t> *bytes) {
+    bytes->clear();
+
+    pthread_mutex_lock(&lock);
+    bytes->swap(consumed);
+    pthread_mutex_unlock(&lock);
+}
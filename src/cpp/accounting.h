@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ACCOUNTING_H
+# define ACCOUNTING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Bytes consumed from each fd by the workers, collected for the main thread.
+ * Counting is off (and free) unless enabled.
+ */
+void AccountingEnable(bool enable);
+void AccountRead(int fd, size_t size);
+void AccountingDrain(std::map<int, uint64_t> *bytes);
+
+/*
+ * Heavy hitters: the fds, or tags given to fds, with the most bytes read,
+ * reads issued and time blocked, each kept in a fixed-size summary.
+ */
+enum HitterMetric {
+    HITTER_BYTES,
+    HITTER_READS,
+    HITTER_BLOCKED_NS,
+    HITTER_METRICS
+};
+
+struct HitterKey {
+    int fd;           // -1 for a tag
+    std::string tag;
+
+    bool operator<(const HitterKey &other) const {
+        return fd != other.fd ? fd < other.fd : tag < other.tag;
+    }
+};
+
+struct HeavyHitter {
+    HitterKey key;
+    uint64_t count;
+    uint64_t error;   // `count` overestimates by at most this much
+};
+
+void HeavyHittersEnable(size_t k);
+bool HeavyHittersSetTag(int fd, const char *tag);
+uint64_t AccountingClock();
+void AccountReadIssued(int fd);
+void AccountBlocked(int fd, uint64_t start);
+void HeavyHittersGet(HitterMetric metric, std::vector<HeavyHitter> *hitters);
+
+#endif /* ACCOUNTING_H */
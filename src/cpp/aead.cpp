@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Authenticated decryption, using the OpenSSL library that Node.js is linked
+ * with.
+ */
+
+#include <openssl/evp.h>
+#include <openssl/opensslv.h>
+
+#include "aead.h"
+
+// OpenSSL < 1.1.0 has no ChaCha20-Poly1305 and only GCM-specific controls.
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L && !defined(OPENSSL_NO_CHACHA) \
+        && !defined(OPENSSL_NO_POLY1305)
+# define HAVE_CHACHA20_POLY1305
+#endif
+#ifndef EVP_CTRL_AEAD_SET_IVLEN
+# define EVP_CTRL_AEAD_SET_IVLEN EVP_CTRL_GCM_SET_IVLEN
+# define EVP_CTRL_AEAD_SET_TAG EVP_CTRL_GCM_SET_TAG
+#endif
+
+static const EVP_CIPHER *GetCipher(AeadAlgorithm algorithm) {
+    switch (algorithm) {
+    case AEAD_AES_256_GCM:
+        return EVP_aes_256_gcm();
+#ifdef HAVE_CHACHA20_POLY1305
+    case AEAD_CHACHA20_POLY1305:
+        return EVP_chacha20_poly1305();
+#endif
+    default:
+        return NULL;
+    }
+}
+
+bool AeadAlgorithmSupported(AeadAlgorithm algorithm) {
+    return GetCipher(algorithm) != NULL;
+}
+
+/*
+ * Verify and decrypt, in place, a message made of a 12-byte nonce, the
+ * ciphertext and a 16-byte tag. `aad` is authenticated too, but not
+ * encrypted. On success, the plaintext starts after the nonce (at
+ * `data + AEAD_NONCE_SIZE`) and its size is returned. Returns -1 if the
+ * message is malformed or was not authenticated.
+ */
+ssize_t AeadDecrypt(const AeadKey &key, const char *aad, size_t aad_size,
+                    char *data, size_t size) {
+    const EVP_CIPHER *cipher = GetCipher(key.algorithm);
+    if (cipher == NULL || size < AEAD_NONCE_SIZE + AEAD_TAG_SIZE)
+        return -1;
+
+    unsigned char *nonce = reinterpret_cast<unsigned char *>(data);
+    unsigned char *text = nonce + AEAD_NONCE_SIZE;
+    int text_size = size - AEAD_NONCE_SIZE - AEAD_TAG_SIZE;
+    unsigned char *tag = text + text_size;
+
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    if (ctx == NULL)
+        return -1;
+
+    int n, ok =
+        EVP_DecryptInit_ex(ctx, cipher, NULL, NULL, NULL) == 1
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, AEAD_NONCE_SIZE,
+                               NULL) == 1
+        && EVP_DecryptInit_ex(ctx, NULL, NULL, key.key, nonce) == 1
+        && (aad_size == 0 || EVP_DecryptUpdate(
+                ctx, NULL, &n, reinterpret_cast<const unsigned char *>(aad),
+                aad_size) == 1)
+        && EVP_DecryptUpdate(ctx, text, &n, text, text_size) == 1
+        && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, AEAD_TAG_SIZE,
+                               tag) == 1
+        && EVP_DecryptFinal_ex(ctx, text + n, &n) == 1;
+
+    EVP_CIPHER_CTX_free(ctx);
+
+    return ok ? text_size : -1;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef AEAD_H
+# define AEAD_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define AEAD_KEY_SIZE 32
+#define AEAD_NONCE_SIZE 12
+#define AEAD_TAG_SIZE 16
+
+enum AeadAlgorithm {
+    AEAD_NONE,
+    AEAD_AES_256_GCM,
+    AEAD_CHACHA20_POLY1305,
+};
+
+struct AeadKey {
+    AeadAlgorithm algorithm;
+    unsigned char key[AEAD_KEY_SIZE];
+};
+
+bool AeadAlgorithmSupported(AeadAlgorithm algorithm);
+
+ssize_t AeadDecrypt(const AeadKey &key, const char *aad, size_t aad_size,
+                    char *data, size_t size);
+
+#endif /* AEAD_H */
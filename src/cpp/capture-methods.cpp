@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <vector>
+
+#include <nan.h>
+#include <uv.h>
+
+#include "capture.h"
+#include "common.h"
+
+static uv_async_t stopped;
+static bool stopped_initialized;
+static std::vector<Nan::Callback *> stop_callbacks;
+
+/*
+ * Executed in the event loop once the writer thread is done.
+ */
+static void OnStopped(uv_async_t *) {
+    Nan::HandleScope scope;
+    std::vector<Nan::Callback *> callbacks;
+    callbacks.swap(stop_callbacks);
+
+    uv_unref(reinterpret_cast<uv_handle_t *>(&stopped));
+    for (size_t i = 0; i < callbacks.size(); i++) {
+        callbacks[i]->Call(0, NULL);
+        delete callbacks[i];
+    }
+}
+
+/*
+ * Called from the writer thread.
+ */
+static void NotifyStopped() {
+    uv_async_send(&stopped);
+}
+
+NAN_METHOD(StartCapture) {
+    if (info.Length() != 2) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'fd' argument.
+     */
+    if (!info[0]->IsNumber() || Nan::To<int>(info[0]).FromJust() < 0) {
+        Nan::ThrowTypeError("first argument should be a file descriptor");
+        return;
+    }
+    int fd = Nan::To<int>(info[0]).FromJust();
+
+    /*
+     * Get 'options' argument.
+     */
+    size_t max_queued_bytes;
+    if (!info[1]->IsObject()
+            || !GetSizeOption(info[1].As<v8::Object>(), "maxQueuedBytes",
+                              16 * 1024 * 1024, &max_queued_bytes)) {
+        Nan::ThrowTypeError("second argument should be an object with valid "
+                            "options");
+        return;
+    }
+
+    if (CaptureStart(fd, max_queued_bytes)) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "cannot start capture: %s",
+                 errno == EBUSY ? "another one is running or still writing"
+                                : strerror(errno));
+        Nan::ThrowError(msg);
+        return;
+    }
+}
+
+NAN_METHOD(StopCapture) {
+    /*
+     * Get optional 'callback' argument, called once what was queued is
+     * written.
+     */
+    if (info.Length() > 1
+            || (info.Length() == 1 && !info[0]->IsFunction())) {
+        Nan::ThrowTypeError("first argument should be a function");
+        return;
+    }
+
+    if (!stopped_initialized) {
+        uv_async_init(uv_default_loop(), &stopped, OnStopped);
+        uv_unref(reinterpret_cast<uv_handle_t *>(&stopped));
+        stopped_initialized = true;
+    }
+
+    if (info.Length() == 1)
+        stop_callbacks.push_back(
+                new Nan::Callback(info[0].As<v8::Function>()));
+
+    // Keep the process alive until the capture is complete.
+    uv_ref(reinterpret_cast<uv_handle_t *>(&stopped));
+    if (!CaptureStop(NotifyStopped))
+        uv_async_send(&stopped);  // nothing to wait for
+}
+
+NAN_METHOD(CaptureStats) {
+    CaptureCounters stats;
+    CaptureGetCounters(&stats);
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    result->Set(Nan::New<v8::String>("capturedBytes").ToLocalChecked(),
+                Nan::New<v8::Number>(stats.captured_bytes));
+    result->Set(Nan::New<v8::String>("droppedBytes").ToLocalChecked(),
+                Nan::New<v8::Number>(stats.dropped_bytes));
+    result->Set(Nan::New<v8::String>("queuedBytes").ToLocalChecked(),
+                Nan::New<v8::Number>(stats.queued_bytes));
+    result->Set(Nan::New<v8::String>("writeErrors").ToLocalChecked(),
+                Nan::New<v8::Number>(stats.write_errors));
+    info.GetReturnValue().Set(result);
+}
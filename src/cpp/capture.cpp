@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+
+#include "capture.h"
+
+#define CAPTURE_MAGIC "PRCAPv1\n"
+#define CAPTURE_HEADER_SIZE 16
+
+struct CaptureRecord {
+    unsigned char header[CAPTURE_HEADER_SIZE];
+    size_t size;
+    char data[1];
+};
+
+/*
+ * The queue is shared between the workers (which fill it) and the writer
+ * thread (which empties it). `enabled` is checked without the lock so that
+ * reads don't pay for anything when capture is off.
+ */
+static std::atomic<bool> enabled(false);
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t not_empty = PTHREAD_COND_INITIALIZER;
+static std::deque<CaptureRecord *> queue;
+static bool stopping;
+static bool writer_running;
+static CaptureStopped on_stopped;
+
+static int capture_fd;
+static size_t max_queued;
+static CaptureCounters stats;
+
+/*
+ * Records are tagged with a connection id rather than the fd, which the next
+ * socket may get once it is closed: a new id is given whenever the inode
+ * behind an fd changes.
+ */
+struct CaptureConnection {
+    ino_t inode;
+    uint32_t id;
+};
+static std::map<int, CaptureConnection> connections;
+static uint32_t next_connection;
+
+/*
+ * Called with `lock` held.
+ */
+static uint32_t ConnectionId(int fd, ino_t inode) {
+    std::map<int, CaptureConnection>::iterator it = connections.find(fd);
+    if (it != connections.end() && it->second.inode == inode)
+        return it->second.id;
+
+    // The top bit is left to bench/record.js
+    CaptureConnection connection = { inode, next_connection++ & 0x7fffffff };
+    connections[fd] = connection;
+    return connection.id;
+}
+
+static void PutLE(unsigned char *bytes, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++)
+        bytes[i] = (value >> (8 * i)) & 0xff;
+}
+
+/*
+ * Write all of `iov`, retrying on short writes. Returns -1 in case of error.
+ */
+static int WriteAll(struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(capture_fd, iov, count);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        while (count > 0 && (size_t) n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = reinterpret_cast<char *>(iov->iov_base) + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    return 0;
+}
+
+static void *WriterThread(void *) {
+    pthread_mutex_lock(&lock);
+
+    for (;;) {
+        while (queue.empty() && !stopping)
+            pthread_cond_wait(&not_empty, &lock);
+        if (queue.empty())
+            break;
+
+        CaptureRecord *record = queue.front();
+        queue.pop_front();
+        pthread_mutex_unlock(&lock);
+
+        struct iovec iov[2] = {
+            { record->header, CAPTURE_HEADER_SIZE },
+            { record->data, record->size },
+        };
+        int err = WriteAll(iov, 2);
+
+        pthread_mutex_lock(&lock);
+        stats.queued_bytes -= record->size;
+        if (err)
+            stats.write_errors++;
+        else
+            stats.captured_bytes += record->size;
+        free(record);
+    }
+
+    CaptureStopped callback = on_stopped;
+    writer_running = false;
+    pthread_mutex_unlock(&lock);
+
+    if (callback != NULL)
+        callback();
+    return NULL;
+}
+
+/*
+ * Start copying consumed data to `fd`. At most `max_queued_bytes` wait to be
+ * written: beyond that, data is dropped rather than slowing down reads.
+ * Returns -1 (see errno) in case of error.
+ */
+int CaptureStart(int fd, size_t max_queued_bytes) {
+    pthread_mutex_lock(&lock);
+    bool busy = writer_running;
+    pthread_mutex_unlock(&lock);
+    if (busy) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    struct iovec iov = {
+        const_cast<char *>(CAPTURE_MAGIC), strlen(CAPTURE_MAGIC) };
+    capture_fd = fd;
+    if (WriteAll(&iov, 1))
+        return -1;
+
+    pthread_mutex_lock(&lock);
+    max_queued = max_queued_bytes;
+    memset(&stats, 0, sizeof(stats));
+    connections.clear();
+    next_connection = 0;
+    stopping = false;
+    on_stopped = NULL;
+    writer_running = true;
+    pthread_mutex_unlock(&lock);
+
+    // Detached, so that stopping never has to wait for a slow capture file.
+    pthread_t writer;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&writer, &attr, WriterThread, NULL);
+    pthread_attr_destroy(&attr);
+    if (err) {
+        pthread_mutex_lock(&lock);
+        writer_running = false;
+        pthread_mutex_unlock(&lock);
+        errno = err;
+        return -1;
+    }
+
+    enabled = true;
+    return 0;
+}
+
+/*
+ * Stop capturing. The writer thread goes on with what is queued, which may
+ * take a while on a slow fd, and calls `callback` from its thread once done.
+ * Returns false if there is no writer left to wait for (`callback` is not
+ * called).
+ */
+bool CaptureStop(CaptureStopped callback) {
+    enabled = false;
+
+    pthread_mutex_lock(&lock);
+    bool running = writer_running;
+    if (running) {
+        stopping = true;
+        on_stopped = callback;
+        pthread_cond_signal(&not_empty);
+    }
+    pthread_mutex_unlock(&lock);
+
+    return running;
+}
+
+void CaptureGetCounters(CaptureCounters *result) {
+    pthread_mutex_lock(&lock);
+    *result = stats;
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Record a chunk of data that was just read from `fd`, with the time it was
+ * read. That is when a worker consumed it, not when it arrived in the kernel:
+ * it follows the pace of the reader. Called from the worker threads.
+ */
+void CaptureData(int fd, const char *data, size_t size) {
+    if (!enabled)
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    struct stat st;
+    ino_t inode = fstat(fd, &st) == -1 ? 0 : st.st_ino;
+
+    pthread_mutex_lock(&lock);
+
+    if (stopping || stats.queued_bytes + size > max_queued) {
+        stats.dropped_bytes += size;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    stats.queued_bytes += size;
+    uint32_t connection = ConnectionId(fd, inode);
+
+    pthread_mutex_unlock(&lock);
+
+    CaptureRecord *record = reinterpret_cast<CaptureRecord *>(
+            malloc(sizeof(CaptureRecord) + size));
+    if (record == NULL) {
+        pthread_mutex_lock(&lock);
+        stats.queued_bytes -= size;
+        stats.dropped_bytes += size;
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+
+    PutLE(&record->header[0], now.tv_sec * 1000000000ULL + now.tv_nsec, 8);
+    PutLE(&record->header[8], connection, 4);
+    PutLE(&record->header[12], size, 4);
+    record->size = size;
+    memcpy(record->data, data, size);
+
+    pthread_mutex_lock(&lock);
+    if (stopping) {  // the writer may be gone already
+        stats.queued_bytes -= size;
+        stats.dropped_bytes += size;
+        free(record);
+    } else {
+        queue.push_back(record);
+        pthread_cond_signal(&not_empty);
+    }
+    pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CAPTURE_H
+# define CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Traffic capture: a copy of every chunk of data consumed by posix-read is
+ * written to a capture fd, by a dedicated thread. See README.md for the file
+ * format.
+ */
+
+struct CaptureCounters {
+    uint64_t captured_bytes;
+    uint64_t dropped_bytes;
+    uint64_t queued_bytes;
+    uint64_t write_errors;
+};
+
+typedef void (*CaptureStopped)();
+
+int CaptureStart(int fd, size_t max_queued_bytes);
+bool CaptureStop(CaptureStopped callback);
+void CaptureGetCounters(CaptureCounters *stats);
+
+void CaptureData(int fd, const char *data, size_t size);
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "chunked.h"
+
+static int HexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/*
+ * Append `[offset, offset + length)` to `spans`, merging it with the last
+ * span if they are contiguous.
+ */
+static void AddSpan(std::vector<FrameSpan> *spans, size_t offset,
+                    size_t length) {
+    if (!spans->empty() &&
+            spans->back().offset + spans->back().length == offset) {
+        spans->back().length += length;
+    } else {
+        FrameSpan span = { offset, length };
+        spans->push_back(span);
+    }
+}
+
+/*
+ * Decode `data`, up to the end of the body if it is in there. Returns the
+ * number of bytes that belong to the body (all of them, unless the decoder
+ * reached CHUNKED_DONE), or -1 if the encoding is invalid. The positions of
+ * chunk data and trailer lines in `data` are appended to `chunks` and
+ * `trailers`. While in CHUNKED_DATA, `chunk_size` tells how much data is still
+ * expected for the current chunk.
+ */
+ssize_t ChunkedFeed(ChunkedDecoder *decoder, const char *data, size_t size,
+                    std::vector<FrameSpan> *chunks,
+                    std::vector<FrameSpan> *trailers) {
+    size_t i = 0;
+
+    while (i < size && decoder->state != CHUNKED_DONE) {
+        char c = data[i];
+
+        switch (decoder->state) {
+        case CHUNKED_SIZE: {
+            int digit = HexValue(c);
+            if (digit != -1) {
+                // 15 hex digits are already far more than any buffer
+                if (++decoder->size_digits > 15)
+                    return -1;
+                decoder->chunk_size = decoder->chunk_size * 16 + digit;
+            } else if (decoder->size_digits == 0) {
+                return -1;
+            } else if (c == ';' || c == ' ' || c == '\t') {
+                decoder->state = CHUNKED_EXTENSION;
+            } else if (c == '\r') {
+                decoder->state = CHUNKED_SIZE_LF;
+            } else {
+                return -1;
+            }
+            i++;
+            break;
+        }
+        case CHUNKED_EXTENSION:
+            if (c == '\r')
+                decoder->state = CHUNKED_SIZE_LF;
+            else if (c == '\n')
+                return -1;
+            i++;
+            break;
+        case CHUNKED_SIZE_LF:
+            if (c != '\n')
+                return -1;
+            i++;
+            decoder->size_digits = 0;
+            if (decoder->chunk_size == 0) {
+                decoder->last_chunk = true;
+                decoder->state = CHUNKED_TRAILER_START;
+            } else {
+                decoder->state = CHUNKED_DATA;
+            }
+            break;
+        case CHUNKED_DATA: {
+            size_t length = size - i;
+            if (length > decoder->chunk_size)
+                length = decoder->chunk_size;
+            AddSpan(chunks, i, length);
+            decoder->chunk_size -= length;
+            i += length;
+            if (decoder->chunk_size == 0)
+                decoder->state = CHUNKED_DATA_CR;
+            break;
+        }
+        case CHUNKED_DATA_CR:
+            if (c != '\r')
+                return -1;
+            decoder->state = CHUNKED_DATA_LF;
+            i++;
+            break;
+        case CHUNKED_DATA_LF:
+            if (c != '\n')
+                return -1;
+            decoder->state = CHUNKED_SIZE;
+            i++;
+            break;
+        case CHUNKED_TRAILER_START:
+            if (c == '\r') {
+                decoder->state = CHUNKED_FINAL_LF;
+            } else {
+                decoder->state = CHUNKED_TRAILER;
+                AddSpan(trailers, i, 1);
+            }
+            i++;
+            break;
+        case CHUNKED_TRAILER:
+            // Trailer lines are kept with their CRLF
+            AddSpan(trailers, i, 1);
+            if (c == '\r')
+                decoder->state = CHUNKED_TRAILER_LF;
+            i++;
+            break;
+        case CHUNKED_TRAILER_LF:
+            if (c != '\n')
+                return -1;
+            AddSpan(trailers, i, 1);
+            decoder->state = CHUNKED_TRAILER_START;
+            i++;
+            break;
+        case CHUNKED_FINAL_LF:
+            if (c != '\n')
+                return -1;
+            decoder->state = CHUNKED_DONE;
+            i++;
+            break;
+        case CHUNKED_DONE:
+            break;
+        }
+    }
+
+    return i;
+}
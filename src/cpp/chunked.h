@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CHUNKED_H
+# define CHUNKED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include "frames.h"
+
+/*
+ * Incremental decoder for HTTP/1.1 chunked transfer-coding (RFC 7230, section
+ * 4.1): chunks of `<hex size>[;extensions]\r\n<data>\r\n`, a last chunk of
+ * size 0, optional trailer fields and a final `\r\n`. Data can be fed in
+ * pieces of any size; the decoder never goes past the end of the body.
+ */
+enum ChunkedState {
+    CHUNKED_SIZE,
+    CHUNKED_EXTENSION,
+    CHUNKED_SIZE_LF,
+    CHUNKED_DATA,
+    CHUNKED_DATA_CR,
+    CHUNKED_DATA_LF,
+    CHUNKED_TRAILER_START,
+    CHUNKED_TRAILER,
+    CHUNKED_TRAILER_LF,
+    CHUNKED_FINAL_LF,
+    CHUNKED_DONE,
+};
+
+struct ChunkedDecoder {
+    ChunkedState state;
+    uint64_t chunk_size;   // size being parsed, then data left in the chunk
+    size_t size_digits;
+    bool last_chunk;
+
+    ChunkedDecoder()
+            : state(CHUNKED_SIZE), chunk_size(0), size_digits(0),
+              last_chunk(false) { }
+};
+
+ssize_t ChunkedFeed(ChunkedDecoder *decoder, const char *data, size_t size,
+                    std::vector<FrameSpan> *chunks,
+                    std::vector<FrameSpan> *trailers);
+
+#endif /* CHUNKED_H */
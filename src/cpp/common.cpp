@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include <nan.h>
+#include <node_buffer.h>
+
+#include "common.h"
+
+/*
+ * Try to check a given argument is actually a `net.Socket` instance. This is
+ * not a strict check and can be easily be fooled. But at least, it should
+ * prevent some trivial programming errors.
+ */
+bool LooksLikeASocket(v8::Local<v8::Value> object) {
+    if (!object->IsObject())
+        return false;
+    v8::Local<v8::Object> socket = object.As<v8::Object>();
+
+    v8::Local<v8::String> className = socket->GetConstructorName();
+    if (strcmp("Socket", *Nan::Utf8String(className->ToString())))
+        return false;
+
+    return true;
+}
+
+/*
+ * Checks if the socket has the 'readable' property set to true.
+ */
+bool SocketIsReadable(v8::Local<v8::Object> socket) {
+    v8::Local<v8::String> key =
+            Nan::New<v8::String>("readable").ToLocalChecked();
+
+    if (!socket->Has(key))
+        return false;
+
+    v8::Local<v8::Value> value = socket->Get(key);
+    return value->IsBoolean() && Nan::To<bool>(value).FromJust();
+}
+
+/*
+ * Make sure the passed socket has a TCP handle, or a Pipe handle (Unix domain
+ * socket), with an associated fd. Returns the fd on success, or -1 in case of
+ * error.
+ */
+int GetFdFromSocket(v8::Local<v8::Object> socket) {
+    v8::Local<v8::String> key;
+    v8::Local<v8::Object> handle;
+    v8::Local<v8::Value> value;
+    v8::Local<v8::String> className;
+
+    key = Nan::New<v8::String>("_handle").ToLocalChecked();
+    if (!socket->Has(key))
+        return -1;
+
+    value = socket->Get(key);
+    if (!value->IsObject())
+        return -1;
+    handle = value.As<v8::Object>();
+
+    className = handle->GetConstructorName();
+    Nan::Utf8String handleType(className->ToString());
+    if (strcmp("TCP", *handleType) && strcmp("Pipe", *handleType))
+        return -1;
+
+    key = Nan::New<v8::String>("fd").ToLocalChecked();
+    if (!handle->Has(key))
+        return -1;
+
+    value = handle->Get(key);
+    if (!value->IsNumber())
+        return -1;
+
+    int fd = Nan::To<int>(value).FromJust();
+
+    if (fd < 0)
+        return -1;
+
+    return fd;
+}
+
+/*
+ * Equivalent of:
+ *
+ * const err = new Error(message);
+ * err[property] = true;
+ */
+v8::Local<v8::Value> ErrorWithProperty(const char *property,
+                                       const char *message) {
+    v8::Local<v8::Value> error = Nan::Error(message);
+
+    v8::Local<v8::String> key = Nan::New<v8::String>(property)
+            .ToLocalChecked();
+    error.As<v8::Object>()->Set(key, Nan::True());
+
+    return error;
+}
+
+/*
+ * Check that a socket can be read from and get its file descriptor. This is
+ * meant for run-time problems (not programmer errors): instead of throwing, it
+ * calls back with a `badStream` error and returns -1.
+ */
+int CheckSocket(v8::Local<v8::Object> socket, Nan::Callback *callback) {
+    if (!SocketIsReadable(socket)) {
+        v8::Local<v8::Value> argv[] = {
+                ErrorWithProperty("badStream", "socket is not readable") };
+        callback->Call(1, argv);
+        delete callback;
+        return -1;
+    }
+    // Check if the 'socket' argument is well-formed and extract its file
+    // descriptor.
+    int fd = GetFdFromSocket(socket);
+    if (fd == -1) {
+        v8::Local<v8::Value> argv[] = { ErrorWithProperty(
+                "badStream",
+                "malformed socket object, cannot get file descriptor") };
+        callback->Call(1, argv);
+        delete callback;
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * Parse a JavaScript array of `[offset, length]` pairs. Offsets must be
+ * non-negative integers and lengths positive integers. Returns false if the
+ * value is not well-formed.
+ */
+bool ParseRanges(v8::Local<v8::Value> value, std::vector<FileRange> *ranges) {
+    if (!value->IsArray())
+        return false;
+    v8::Local<v8::Array> array = value.As<v8::Array>();
+
+    if (array->Length() == 0)
+        return false;
+
+    for (uint32_t i = 0; i < array->Length(); i++) {
+        v8::Local<v8::Value> item = array->Get(i);
+        if (!item->IsArray() || item.As<v8::Array>()->Length() != 2)
+            return false;
+
+        v8::Local<v8::Value> offset = item.As<v8::Array>()->Get(0);
+        v8::Local<v8::Value> length = item.As<v8::Array>()->Get(1);
+        if (!offset->IsNumber() || !length->IsNumber())
+            return false;
+
+        double o = Nan::To<double>(offset).FromJust();
+        double l = Nan::To<double>(length).FromJust();
+        if (o < 0 || o != static_cast<int64_t>(o) || o > (1LL << 53))
+            return false;
+        if (l <= 0 || l != static_cast<int64_t>(l)
+                || l > node::Buffer::kMaxLength)
+            return false;
+
+        FileRange range = { static_cast<off_t>(o), static_cast<size_t>(l) };
+        ranges->push_back(range);
+    }
+
+    return true;
+}
+
+/*
+ * Equivalent of `buffer.slice(offset, offset + length)`: returns a new Buffer
+ * sharing the memory of `buffer`, without copying.
+ */
+v8::Local<v8::Object> NewBufferView(v8::Local<v8::Object> buffer,
+                                    size_t offset, size_t length) {
+    v8::Local<v8::Uint8Array> array = buffer.As<v8::Uint8Array>();
+
+    return node::Buffer::New(v8::Isolate::GetCurrent(), array->Buffer(),
+                             array->ByteOffset() + offset, length)
+            .ToLocalChecked();
+}
+
+/*
+ * Parse a length prefix description: 'UInt8', 'UInt16BE', 'UInt16LE',
+ * 'UInt32BE' or 'UInt32LE'. Returns false if it is none of these.
+ */
+bool ParsePrefixSpec(v8::Local<v8::Value> value, PrefixSpec *prefix) {
+    static const struct {
+        const char *name;
+        PrefixSpec spec;
+    } specs[] = {
+        { "UInt8", { 1, true } },
+        { "UInt16BE", { 2, true } },
+        { "UInt16LE", { 2, false } },
+        { "UInt32BE", { 4, true } },
+        { "UInt32LE", { 4, false } },
+    };
+
+    if (!value->IsString())
+        return false;
+
+    Nan::Utf8String name(value);
+    for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++) {
+        if (!strcmp(specs[i].name, *name)) {
+            *prefix = specs[i].spec;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Get an optional positive integer property of an options object. Returns
+ * false if it is present but not a positive integer.
+ */
+bool GetSizeOption(v8::Local<v8::Object> options, const char *name,
+                   size_t default_value, size_t *value) {
+    v8::Local<v8::String> key = Nan::New<v8::String>(name).ToLocalChecked();
+
+    if (!options->Has(key)) {
+        *value = default_value;
+        return true;
+    }
+
+    v8::Local<v8::Value> option = options->Get(key);
+    if (!option->IsNumber())
+        return false;
+
+    double number = Nan::To<double>(option).FromJust();
+    if (number <= 0 || number != static_cast<int64_t>(number)
+            || number > node::Buffer::kMaxLength)
+        return false;
+
+    *value = static_cast<size_t>(number);
+    return true;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef COMMON_H
+# define COMMON_H
+
+#include <sys/types.h>
+
+#include <vector>
+
+#include <nan.h>
+
+#include "frames.h"
+
+struct FileRange {
+    off_t offset;
+    size_t length;
+};
+
+bool LooksLikeASocket(v8::Local<v8::Value> object);
+bool SocketIsReadable(v8::Local<v8::Object> socket);
+int GetFdFromSocket(v8::Local<v8::Object> socket);
+int CheckSocket(v8::Local<v8::Object> socket, Nan::Callback *callback);
+
+v8::Local<v8::Value> ErrorWithProperty(const char *property,
+                                       const char *message);
+
+bool ParseRanges(v8::Local<v8::Value> value, std::vector<FileRange> *ranges);
+v8::Local<v8::Object> NewBufferView(v8::Local<v8::Object> buffer,
+                                    size_t offset, size_t length);
+
+bool ParsePrefixSpec(v8::Local<v8::Value> value, PrefixSpec *prefix);
+bool GetSizeOption(v8::Local<v8::Object> options, const char *name,
+                   size_t default_value, size_t *value);
+
+#endif /* COMMON_H */
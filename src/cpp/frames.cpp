@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "frames.h"
+
+uint64_t DecodePrefix(const PrefixSpec &prefix, const char *data) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    uint64_t value = 0;
+
+    for (size_t i = 0; i < prefix.size; i++)
+        value = (value << 8) |
+                bytes[prefix.big_endian ? i : prefix.size - 1 - i];
+
+    return value;
+}
+
+/*
+ * Find the complete frames at the beginning of `data`, up to `max_frames`.
+ * Returns the number of bytes they span (prefixes included) and appends their
+ * payloads to `frames`. If no frame is complete, `next_size` is set to the
+ * number of bytes needed to go further: the size of the first frame, or the
+ * size of the prefix if even that is incomplete.
+ */
+size_t ScanFrames(const PrefixSpec &prefix, const char *data, size_t size,
+                  size_t max_frames, std::vector<FrameSpan> *frames,
+                  uint64_t *next_size) {
+    size_t offset = 0;
+
+    *next_size = 0;
+
+    while (frames->size() < max_frames) {
+        if (size - offset < prefix.size) {
+            *next_size = offset + prefix.size;
+            break;
+        }
+
+        uint64_t length = DecodePrefix(prefix, &data[offset]);
+        if (length > size - offset - prefix.size) {
+            *next_size = offset + prefix.size + length;
+            break;
+        }
+
+        FrameSpan frame = { offset + prefix.size, (size_t) length };
+        frames->push_back(frame);
+        offset += prefix.size + length;
+    }
+
+    return offset;
+}
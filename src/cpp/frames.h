@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FRAMES_H
+# define FRAMES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/*
+ * Length-prefixed frames: a big- or little-endian unsigned integer of 1, 2 or
+ * 4 bytes, giving the size of the payload that follows.
+ */
+struct PrefixSpec {
+    size_t size;
+    bool big_endian;
+};
+
+/*
+ * Where the payload of a frame is, relatively to the start of the data.
+ */
+struct FrameSpan {
+    size_t offset;
+    size_t length;
+};
+
+uint64_t DecodePrefix(const PrefixSpec &prefix, const char *data);
+
+size_t ScanFrames(const PrefixSpec &prefix, const char *data, size_t size,
+                  size_t max_frames, std::vector<FrameSpan> *frames,
+                  uint64_t *next_size);
+
+#endif /* FRAMES_H */
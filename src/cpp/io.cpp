@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "accounting.h"
+#include "capture.h"
+#include "io.h"
+#include "ktls.h"
+
+/*
+ * Set the socket blocking, if it was not.
+ */
+int SetBlocking(int fd, bool *was_non_blocking) {
+    int opts = fcntl(fd, F_GETFL);
+    if (opts == -1)
+        return -1;
+
+    *was_non_blocking = opts & O_NONBLOCK;
+
+    if (*was_non_blocking) {
+        opts &= ~O_NONBLOCK;
+        if (fcntl(fd, F_SETFL, opts) == -1)
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Reset the socket like in the mode (blocking vs. non-blocking) it was.
+ */
+int UnsetBlocking(int fd, bool was_non_blocking) {
+    if (was_non_blocking) {
+        int opts = fcntl(fd, F_GETFL);
+        if (opts == -1)
+            return -1;
+
+        opts |= O_NONBLOCK;
+        if (fcntl(fd, F_SETFL, opts) == -1)
+            return -1;
+    }
+
+    return 0;
+}
+
+static ssize_t ReadLoop(int fd, char *data, size_t size) {
+    size_t count = 0;
+
+    do {
+        ssize_t n = read(fd, &data[count], size - count);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EIO && KtlsHandleControlRecord(fd) == 0)
+                break;  // end of TLS stream
+            return -1;
+        } else if (n == 0) {  // end of stream
+            break;
+        } else {
+            CaptureData(fd, &data[count], n);
+            AccountRead(fd, n);
+            count += n;
+        }
+    } while (count < size);
+
+    return count;
+}
+
+/*
+ * Read exactly `size` bytes, retrying on short reads and interruptions.
+ * Returns the number of bytes read, which is less than `size` if the end of
+ * stream was reached first, or -1 in case of error.
+ */
+ssize_t ReadExactly(int fd, char *data, size_t size) {
+    uint64_t start = AccountingClock();
+    ssize_t count = ReadLoop(fd, data, size);
+    AccountBlocked(fd, start);
+
+    return count;
+}
+
+/*
+ * recv(2) with MSG_PEEK and `flags`, retrying on interruptions. Like reads, a
+ * peek fails with EIO on a kTLS socket whose next record is not application
+ * data: a close_notify alert is then consumed and reported as the end of
+ * stream (0).
+ */
+ssize_t Peek(int fd, char *data, size_t size, int flags) {
+    for (;;) {
+        ssize_t n = recv(fd, data, size, MSG_PEEK | flags);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EIO && KtlsHandleControlRecord(fd) == 0)
+                return 0;  // end of TLS stream
+        }
+        return n;
+    }
+}
+
+/*
+ * Wait until `size` bytes are queued in a socket and copy them, without
+ * consuming them. Returns the number of bytes copied, which is less than
+ * `size` if the end of stream was reached first, or -1 in case of error.
+ */
+ssize_t PeekExactly(int fd, char *data, size_t size) {
+    uint64_t start = AccountingClock();
+    ssize_t n = Peek(fd, data, size, MSG_WAITALL);
+    AccountBlocked(fd, start);
+
+    return n;
+}
+
+/*
+ * Number of bytes that can be read right now without blocking: what remains
+ * after the current offset for a regular file, what is queued in the kernel
+ * for a socket or a pipe. Returns -1 in case of error.
+ */
+ssize_t AvailableBytes(int fd, bool *is_file) {
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        return -1;
+
+    *is_file = S_ISREG(st.st_mode);
+
+    if (*is_file) {
+        off_t offset = lseek(fd, 0, SEEK_CUR);
+        if (offset == -1)
+            return -1;
+        return st.st_size > offset ? st.st_size - offset : 0;
+    }
+
+    int queued;
+    if (ioctl(fd, FIONREAD, &queued) == -1)
+        return -1;
+    return queued;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef IO_H
+# define IO_H
+
+#include <sys/types.h>
+
+/*
+ * Plain POSIX helpers shared by the workers. They don't depend on V8 and are
+ * safe to call from worker threads.
+ */
+
+int SetBlocking(int fd, bool *was_non_blocking);
+int UnsetBlocking(int fd, bool was_non_blocking);
+
+ssize_t ReadExactly(int fd, char *data, size_t size);
+ssize_t Peek(int fd, char *data, size_t size, int flags);
+ssize_t PeekExactly(int fd, char *data, size_t size);
+ssize_t AvailableBytes(int fd, bool *is_file);
+
+#endif /* IO_H */
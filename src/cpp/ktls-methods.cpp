@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <nan.h>
+#include <node_buffer.h>
+
+#include "common.h"
+#include "ktls.h"
+
+/*
+ * Parse `{ version, cipher, key, iv, sequence }`. Returns false if something
+ * is missing or invalid.
+ */
+static bool ParseKtlsParams(v8::Local<v8::Object> options,
+                            KtlsParams *params) {
+    Nan::Utf8String version(options->Get(
+            Nan::New<v8::String>("version").ToLocalChecked()));
+    if (!strcmp("TLSv1.2", *version))
+        params->tls13 = false;
+    else if (!strcmp("TLSv1.3", *version))
+        params->tls13 = true;
+    else
+        return false;
+
+    Nan::Utf8String cipher(options->Get(
+            Nan::New<v8::String>("cipher").ToLocalChecked()));
+    if (!strcmp("aes-128-gcm", *cipher))
+        params->cipher = KTLS_AES_128_GCM;
+    else if (!strcmp("aes-256-gcm", *cipher))
+        params->cipher = KTLS_AES_256_GCM;
+    else if (!strcmp("chacha20-poly1305", *cipher))
+        params->cipher = KTLS_CHACHA20_POLY1305;
+    else
+        return false;
+
+    v8::Local<v8::Value> key = options->Get(
+            Nan::New<v8::String>("key").ToLocalChecked());
+    if (!node::Buffer::HasInstance(key)
+            || node::Buffer::Length(key) != KtlsKeySize(params->cipher))
+        return false;
+    memcpy(params->key, node::Buffer::Data(key), node::Buffer::Length(key));
+
+    v8::Local<v8::Value> iv = options->Get(
+            Nan::New<v8::String>("iv").ToLocalChecked());
+    if (!node::Buffer::HasInstance(iv)
+            || node::Buffer::Length(iv) != sizeof(params->iv))
+        return false;
+    memcpy(params->iv, node::Buffer::Data(iv), sizeof(params->iv));
+
+    params->sequence = 0;
+    v8::Local<v8::String> name = Nan::New<v8::String>("sequence")
+            .ToLocalChecked();
+    if (options->Has(name)) {
+        v8::Local<v8::Value> sequence = options->Get(name);
+        if (!sequence->IsNumber())
+            return false;
+        double number = Nan::To<double>(sequence).FromJust();
+        if (number < 0 || number != static_cast<int64_t>(number))
+            return false;
+        params->sequence = static_cast<uint64_t>(number);
+    }
+
+    return true;
+}
+
+NAN_METHOD(EnableKtlsRx) {
+    if (info.Length() != 2) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' argument.
+     */
+    if (!LooksLikeASocket(info[0])) {
+        Nan::ThrowTypeError("first argument should be a socket");
+        return;
+    }
+    int fd = GetFdFromSocket(info[0].As<v8::Object>());
+    if (fd == -1) {
+        Nan::ThrowTypeError("malformed socket object, cannot get file "
+                            "descriptor");
+        return;
+    }
+
+    /*
+     * Get 'options' argument.
+     */
+    KtlsParams params;
+    if (!info[1]->IsObject()
+            || !ParseKtlsParams(info[1].As<v8::Object>(), &params)) {
+        Nan::ThrowTypeError("second argument should be an object with valid "
+                            "TLS parameters");
+        return;
+    }
+
+    int err = KtlsEnableRx(fd, params);
+    memset(&params, 0, sizeof(params));
+    if (err) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "cannot enable kernel TLS: %s",
+                 strerror(errno));
+        Nan::ThrowError(msg);
+        return;
+    }
+}
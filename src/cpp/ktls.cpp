@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Kernel TLS (kTLS) reception: once the receive keys of a connection are
+ * given to the kernel, it decrypts records itself, and read(2) returns the
+ * plaintext of application data records. See
+ * https://docs.kernel.org/networking/tls.html
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#ifdef __linux__
+# include <linux/tls.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+#endif
+
+#include "ktls.h"
+
+#ifndef SOL_TLS
+# define SOL_TLS 282
+#endif
+
+#define TLS_RECORD_ALERT 21
+#define TLS_ALERT_CLOSE_NOTIFY 0
+
+size_t KtlsKeySize(KtlsCipher cipher) {
+    return cipher == KTLS_AES_128_GCM ? 16 : 32;
+}
+
+#ifdef __linux__
+
+/*
+ * Fill one of the tls12_crypto_info_* structures, which all have the same
+ * fields, of different sizes.
+ */
+template <typename Info>
+static int SetRxInfo(int fd, const KtlsParams &params, Info *info,
+                     unsigned short cipher_type, size_t salt_size) {
+    memset(info, 0, sizeof(*info));
+    info->info.version = params.tls13 ? TLS_1_3_VERSION : TLS_1_2_VERSION;
+    info->info.cipher_type = cipher_type;
+    memcpy(info->key, params.key, sizeof(info->key));
+    memcpy(info->salt, params.iv, salt_size);
+    memcpy(info->iv, &params.iv[salt_size], sizeof(info->iv));
+    for (size_t i = 0; i < sizeof(info->rec_seq); i++)
+        info->rec_seq[i] = params.sequence >> (8 * (7 - i));
+
+    return setsockopt(fd, SOL_TLS, TLS_RX, info, sizeof(*info));
+}
+
+/*
+ * Attach the TLS upper layer protocol to a TCP socket and give it the
+ * receive keys. Returns -1 in case of error (ENOENT if the kernel has no
+ * `tls` module).
+ */
+int KtlsEnableRx(int fd, const KtlsParams &params) {
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == -1 &&
+            errno != EEXIST)
+        return -1;
+
+    switch (params.cipher) {
+    case KTLS_AES_128_GCM: {
+        struct tls12_crypto_info_aes_gcm_128 info;
+        return SetRxInfo(fd, params, &info, TLS_CIPHER_AES_GCM_128, 4);
+    }
+    case KTLS_AES_256_GCM: {
+        struct tls12_crypto_info_aes_gcm_256 info;
+        return SetRxInfo(fd, params, &info, TLS_CIPHER_AES_GCM_256, 4);
+    }
+    case KTLS_CHACHA20_POLY1305: {
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+        struct tls12_crypto_info_chacha20_poly1305 info;
+        return SetRxInfo(fd, params, &info, TLS_CIPHER_CHACHA20_POLY1305, 0);
+#endif
+    }
+    }
+
+    errno = ENOTSUP;
+    return -1;
+}
+
+/*
+ * Called when read(2) failed with EIO, which a kTLS socket does when the next
+ * record is not application data. A close_notify alert is consumed and
+ * returns 0 (the end of stream); any other record is left in the socket and
+ * errno is set to EPROTO, since it needs a TLS stack to be handled. Returns
+ * -1 with errno unchanged if the socket doesn't use kTLS.
+ */
+int KtlsHandleControlRecord(int fd) {
+    char ulp[16] = "";
+    socklen_t ulp_len = sizeof(ulp);
+    if (getsockopt(fd, SOL_TCP, TCP_ULP, ulp, &ulp_len) == -1 ||
+            strcmp(ulp, "tls")) {
+        errno = EIO;
+        return -1;
+    }
+
+    for (;;) {
+        unsigned char alert[2];
+        struct iovec iov = { alert, sizeof(alert) };
+        char control[CMSG_SPACE(sizeof(unsigned char))];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t n = recvmsg(fd, &msg, MSG_PEEK);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg == NULL || cmsg->cmsg_level != SOL_TLS ||
+                cmsg->cmsg_type != TLS_GET_RECORD_TYPE) {
+            errno = EPROTO;
+            return -1;
+        }
+
+        unsigned char record_type = *CMSG_DATA(cmsg);
+        if (record_type != TLS_RECORD_ALERT || n < 2 ||
+                alert[1] != TLS_ALERT_CLOSE_NOTIFY) {
+            errno = EPROTO;
+            return -1;
+        }
+
+        // Consume the close_notify alert.
+        do {
+            msg.msg_controllen = sizeof(control);
+            n = recvmsg(fd, &msg, 0);
+        } while (n == -1 && errno == EINTR);
+        return n == -1 ? -1 : 0;
+    }
+}
+
+#else  /* !__linux__ */
+
+int KtlsEnableRx(int, const KtlsParams &) {
+    errno = ENOTSUP;
+    return -1;
+}
+
+int KtlsHandleControlRecord(int) {
+    errno = EIO;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef KTLS_H
+# define KTLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum KtlsCipher {
+    KTLS_AES_128_GCM,
+    KTLS_AES_256_GCM,
+    KTLS_CHACHA20_POLY1305,
+};
+
+/*
+ * Receive keys of an established TLS connection. `iv` is the 12-byte nonce
+ * base: the 4-byte implicit IV (salt) followed by 8 bytes for AES-GCM in TLS
+ * 1.2 (the explicit part comes with each record, they can be zeros), or the
+ * whole IV otherwise.
+ */
+struct KtlsParams {
+    bool tls13;
+    KtlsCipher cipher;
+    unsigned char key[32];
+    unsigned char iv[12];
+    uint64_t sequence;  // of the next record to be received
+};
+
+size_t KtlsKeySize(KtlsCipher cipher);
+int KtlsEnableRx(int fd, const KtlsParams &params);
+int KtlsHandleControlRecord(int fd);
+
+#endif /* KTLS_H */
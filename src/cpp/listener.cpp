@@ -0,0 +1,462 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <map>
+
+#include <nan.h>
+#include <uv.h>
+
+#include "common.h"
+#include "io.h"
+#include "rate-limit.h"
+#include "read-worker.h"
+
+/*
+ * A listening socket that is not managed by Node.js: it is watched by a
+ * uv_poll_t, and connections are accepted in batches as soon as it is
+ * readable. Each connection can be read from (or peeked) before being handed
+ * to JavaScript.
+ */
+struct Listener {
+    uv_poll_t handle;
+    uv_timer_t retry;
+    int open_handles;
+    int fd;
+    Nan::Callback *callback;
+
+    size_t max_accepts;
+    size_t first_read;
+    bool peek;
+    unsigned int timeout_ms;
+
+    uint64_t backoff_ms;  // 0 unless accept() is failing
+};
+
+static std::map<int, Listener *> listeners;
+
+/*
+ * Reads the first bytes of a freshly accepted connection, then passes them
+ * along with the connection fd. In case of error, the connection is closed.
+ */
+class FirstReadWorker : public ReadWorker {
+ private:
+    int fd;
+    bool fd_was_non_blocking;
+
+    size_t size;
+    bool peek;
+    unsigned int timeout_ms;
+    char *data;
+
+    int SetTimeout(unsigned int ms) {
+        struct timeval tv;
+        tv.tv_sec = ms / 1000;
+        tv.tv_usec = (ms % 1000) * 1000;
+        return setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+ public:
+    FirstReadWorker(Nan::Callback *callback, int fd, size_t size, bool peek,
+                    unsigned int timeout_ms)
+            : ReadWorker(callback), fd(fd), size(size), peek(peek),
+              timeout_ms(timeout_ms) { }
+
+    ~FirstReadWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        data = reinterpret_cast<char *>(malloc(size));
+        if (data == NULL) {
+            SetSystemError("malloc", errno);
+            return;
+        }
+
+        if (SetBlocking(fd, &fd_was_non_blocking)) {
+            SetSystemError("fcntl", errno);
+            free(data);
+            return;
+        }
+
+        if (timeout_ms && SetTimeout(timeout_ms)) {
+            SetSystemError("setsockopt", errno);
+            free(data);
+            return;
+        }
+
+        ssize_t count = peek ? PeekExactly(fd, data, size)
+                             : ReadExactly(fd, data, size);
+        if (count == -1) {
+            SetSystemError(peek ? "recv" : "read", errno);
+            free(data);
+        } else if ((size_t) count < size) {  // end of stream
+            SetEndOfFile(count);
+            free(data);
+        }
+
+        if (timeout_ms && !HasError() && SetTimeout(0)) {
+            SetSystemError("setsockopt", errno);
+            free(data);
+        }
+
+        if (UnsetBlocking(fd, fd_was_non_blocking)) {
+            if (!HasError()) {
+                SetSystemError("fcntl", errno);
+                free(data);
+            }
+        }
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        v8::Local<v8::Object> buffer =
+                Nan::NewBuffer(data, (uint32_t) size).ToLocalChecked();
+
+        v8::Local<v8::Value> argv[] = {
+                Nan::Null(), Nan::New<v8::Int32>(fd), buffer };
+        callback->Call(3, argv);
+    }
+
+    void HandleErrorCallback() {
+        close(fd);
+
+        ReadWorker::HandleErrorCallback();
+    }
+};
+
+static int AcceptConnection(int fd) {
+#ifdef __linux__
+    return accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+    int client = accept(fd, NULL, NULL);
+    if (client != -1) {
+        fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+    }
+    return client;
+#endif
+}
+
+static void OnListenerReadable(uv_poll_t *handle, int status,
+                               int /* events */);
+
+static void OnRetry(uv_timer_t *handle) {
+    Listener *listener = reinterpret_cast<Listener *>(handle->data);
+
+    uv_poll_start(&listener->handle, UV_READABLE, OnListenerReadable);
+}
+
+/*
+ * accept() keeps failing as long as the cause is there (e.g. EMFILE), and
+ * the listening socket stays readable: stop watching it for a while, longer
+ * each time, and only report the first error of a series.
+ */
+static void BackOff(Listener *listener, int errnum) {
+    bool first = listener->backoff_ms == 0;
+    listener->backoff_ms = first ? 10 : listener->backoff_ms * 2;
+    if (listener->backoff_ms > 1000)
+        listener->backoff_ms = 1000;
+
+    uv_poll_stop(&listener->handle);
+    uv_timer_start(&listener->retry, OnRetry, listener->backoff_ms, 0);
+
+    if (!first)
+        return;
+
+    char msg[256];
+    snprintf(msg, sizeof(msg), "accept failed: %s", strerror(errnum));
+    v8::Local<v8::Value> argv[] = { ErrorWithProperty("systemError", msg) };
+    listener->callback->Call(1, argv);
+}
+
+static void OnListenerReadable(uv_poll_t *handle, int status,
+                               int /* events */) {
+    Nan::HandleScope scope;
+    Listener *listener = reinterpret_cast<Listener *>(handle->data);
+
+    if (status < 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "poll failed: %s", uv_strerror(status));
+        v8::Local<v8::Value> argv[] = {
+                ErrorWithProperty("systemError", msg) };
+        listener->callback->Call(1, argv);
+        return;
+    }
+
+    for (size_t i = 0; i < listener->max_accepts; i++) {
+        int fd = AcceptConnection(listener->fd);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            BackOff(listener, errno);
+            break;
+        }
+        listener->backoff_ms = 0;
+
+        if (listener->first_read == 0) {
+            v8::Local<v8::Value> argv[] = {
+                    Nan::Null(), Nan::New<v8::Int32>(fd), Nan::Undefined() };
+            listener->callback->Call(3, argv);
+            continue;
+        }
+
+        // The worker owns (and frees) its callback.
+        Nan::Callback *callback =
+                new Nan::Callback(listener->callback->GetFunction());
+        QueueReadWorker(fd, new FirstReadWorker(
+                callback, fd, listener->first_read, listener->peek,
+                listener->timeout_ms));
+    }
+}
+
+static void OnListenerClosed(uv_handle_t *handle) {
+    Listener *listener = reinterpret_cast<Listener *>(handle->data);
+
+    if (--listener->open_handles > 0)
+        return;
+
+    close(listener->fd);
+    delete listener->callback;
+    delete listener;
+}
+
+/*
+ * Create, bind and listen on a TCP socket. Returns the socket, or -1 in case
+ * of error (see errno), in which case `*syscall` tells what failed.
+ */
+static int CreateListeningSocket(const char *host, int port, int backlog,
+                                 int defer_accept, const char **syscall) {
+    struct sockaddr_storage address;
+    socklen_t address_size;
+    memset(&address, 0, sizeof(address));
+
+    struct sockaddr_in *in4 = reinterpret_cast<struct sockaddr_in *>(&address);
+    struct sockaddr_in6 *in6 =
+            reinterpret_cast<struct sockaddr_in6 *>(&address);
+    if (inet_pton(AF_INET, host, &in4->sin_addr) == 1) {
+        in4->sin_family = AF_INET;
+        in4->sin_port = htons(port);
+        address_size = sizeof(*in4);
+    } else if (inet_pton(AF_INET6, host, &in6->sin6_addr) == 1) {
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        address_size = sizeof(*in6);
+    } else {
+        *syscall = "inet_pton";
+        errno = EINVAL;
+        return -1;
+    }
+
+    *syscall = "socket";
+    int fd = socket(address.ss_family, SOCK_STREAM, 0);
+    if (fd == -1)
+        return -1;
+
+    int one = 1;
+    *syscall = "setsockopt";
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == -1)
+        goto error;
+#ifdef TCP_DEFER_ACCEPT
+    if (defer_accept && setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                                   &defer_accept, sizeof(defer_accept)) == -1)
+        goto error;
+#endif
+
+    *syscall = "fcntl";
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1
+            || fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
+        goto error;
+
+    *syscall = "bind";
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&address),
+             address_size) == -1)
+        goto error;
+
+    *syscall = "listen";
+    if (listen(fd, backlog) == -1)
+        goto error;
+
+    return fd;
+
+error:
+    int err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+}
+
+static int GetPort(int fd) {
+    struct sockaddr_storage address;
+    socklen_t address_size = sizeof(address);
+
+    if (getsockname(fd, reinterpret_cast<struct sockaddr *>(&address),
+                    &address_size) == -1)
+        return -1;
+
+    if (address.ss_family == AF_INET6)
+        return ntohs(reinterpret_cast<struct sockaddr_in6 *>(&address)
+                     ->sin6_port);
+    return ntohs(reinterpret_cast<struct sockaddr_in *>(&address)->sin_port);
+}
+
+NAN_METHOD(Listen) {
+    if (info.Length() != 2) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'options' argument.
+     */
+    if (!info[0]->IsObject()) {
+        Nan::ThrowTypeError("first argument should be an object");
+        return;
+    }
+    v8::Local<v8::Object> options = info[0].As<v8::Object>();
+
+    v8::Local<v8::String> key = Nan::New<v8::String>("port")
+            .ToLocalChecked();
+    int port = 0;
+    if (options->Has(key)) {
+        v8::Local<v8::Value> value = options->Get(key);
+        port = value->IsNumber() ? Nan::To<int>(value).FromJust() : -1;
+    }
+
+    size_t backlog, defer_accept, max_accepts, first_read, timeout_ms;
+    if (port < 0 || port > 65535
+            || !GetSizeOption(options, "backlog", 511, &backlog)
+            || !GetSizeOption(options, "deferAccept", 0, &defer_accept)
+            || !GetSizeOption(options, "maxAccepts", 64, &max_accepts)
+            || !GetSizeOption(options, "firstRead", 0, &first_read)
+            || !GetSizeOption(options, "firstReadTimeout", 0, &timeout_ms)) {
+        Nan::ThrowTypeError("first argument should be an object with valid "
+                            "options");
+        return;
+    }
+
+    key = Nan::New<v8::String>("host").ToLocalChecked();
+    v8::Local<v8::Value> host_value = options->Has(key) ? options->Get(key)
+            : Nan::New<v8::String>("0.0.0.0").ToLocalChecked()
+                    .As<v8::Value>();
+    Nan::Utf8String host(host_value);
+
+    key = Nan::New<v8::String>("peek").ToLocalChecked();
+    bool peek = options->Has(key) && Nan::To<bool>(options->Get(key))
+            .FromJust();
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[1]->IsFunction()) {
+        Nan::ThrowTypeError("second argument should be a function");
+        return;
+    }
+
+    const char *syscall;
+    int fd = CreateListeningSocket(*host, port, backlog, defer_accept,
+                                   &syscall);
+    if (fd == -1) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "%s failed: %s", syscall, strerror(errno));
+        Nan::ThrowError(msg);
+        return;
+    }
+
+    Listener *listener = new Listener();
+    listener->fd = fd;
+    listener->callback = new Nan::Callback(info[1].As<v8::Function>());
+    listener->max_accepts = max_accepts;
+    listener->first_read = first_read;
+    listener->peek = peek;
+    listener->timeout_ms = timeout_ms;
+    listener->handle.data = listener;
+    listener->retry.data = listener;
+
+    uv_timer_init(Nan::GetCurrentEventLoop(), &listener->retry);
+    listener->open_handles = 1;
+
+    int err = uv_poll_init(Nan::GetCurrentEventLoop(), &listener->handle, fd);
+    if (err) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "cannot poll socket: %s",
+                 uv_strerror(err));
+        Nan::ThrowError(msg);
+        uv_close(reinterpret_cast<uv_handle_t *>(&listener->retry),
+                 OnListenerClosed);
+        return;
+    }
+    listener->open_handles = 2;
+    uv_poll_start(&listener->handle, UV_READABLE, OnListenerReadable);
+
+    listeners[fd] = listener;
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    result->Set(Nan::New<v8::String>("fd").ToLocalChecked(),
+                Nan::New<v8::Int32>(fd));
+    result->Set(Nan::New<v8::String>("port").ToLocalChecked(),
+                Nan::New<v8::Int32>(GetPort(fd)));
+    info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(CloseListener) {
+    if (info.Length() != 1 || !info[0]->IsNumber()) {
+        Nan::ThrowTypeError("first argument should be a listener");
+        return;
+    }
+
+    std::map<int, Listener *>::iterator it =
+            listeners.find(Nan::To<int>(info[0]).FromJust());
+    if (it == listeners.end())
+        return;
+
+    Listener *listener = it->second;
+    listeners.erase(it);
+
+    uv_poll_stop(&listener->handle);
+    uv_close(reinterpret_cast<uv_handle_t *>(&listener->handle),
+             OnListenerClosed);
+    uv_timer_stop(&listener->retry);
+    uv_close(reinterpret_cast<uv_handle_t *>(&listener->retry),
+             OnListenerClosed);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Minimal decoder for the LZ4 block format, as described in
+ * https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ *
+ * Only decompression is needed, and it is small enough to live here rather
+ * than depending on liblz4.
+ */
+
+#include <string.h>
+
+#include "lz4.h"
+
+/*
+ * Read a length made of a 4-bit value from the token, extended by bytes as
+ * long as they are 255. Returns false if the input ends before.
+ */
+static bool ReadLength(const unsigned char **ip, const unsigned char *iend,
+                       size_t *length) {
+    if (*length != 15)
+        return true;
+
+    unsigned char byte;
+    do {
+        if (*ip >= iend)
+            return false;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+/*
+ * Decompress a block into `dst`. Returns the decompressed size, or -1 if the
+ * input is malformed or would not fit in `dst_size` bytes.
+ */
+ssize_t Lz4DecompressBlock(const char *src, size_t src_size, char *dst,
+                           size_t dst_size) {
+    const unsigned char *ip = reinterpret_cast<const unsigned char *>(src);
+    const unsigned char *iend = ip + src_size;
+    unsigned char *op = reinterpret_cast<unsigned char *>(dst);
+    unsigned char *ostart = op;
+    unsigned char *oend = op + dst_size;
+
+    while (ip < iend) {
+        unsigned char token = *ip++;
+
+        // Literals
+        size_t length = token >> 4;
+        if (!ReadLength(&ip, iend, &length))
+            return -1;
+        if (length > (size_t) (iend - ip) || length > (size_t) (oend - op))
+            return -1;
+        memcpy(op, ip, length);
+        ip += length;
+        op += length;
+
+        // The last sequence only has literals.
+        if (ip == iend)
+            break;
+
+        // Match
+        if (iend - ip < 2)
+            return -1;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - ostart))
+            return -1;
+
+        length = token & 15;
+        if (!ReadLength(&ip, iend, &length))
+            return -1;
+        length += 4;
+        if (length > (size_t) (oend - op))
+            return -1;
+
+        const unsigned char *match = op - offset;
+        if (offset >= length) {
+            memcpy(op, match, length);
+            op += length;
+        } else {  // overlapping copy, repeats the last `offset` bytes
+            while (length--)
+                *op++ = *match++;
+        }
+    }
+
+    return op - ostart;
+}
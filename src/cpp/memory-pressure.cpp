@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Reaction to memory pressure, as reported by the kernel's pressure stall
+ * information (PSI): a trigger is registered on the `memory.pressure` file of
+ * our cgroup (v2), or on /proc/pressure/memory, and polled by the event loop.
+ * On each event, idle pools are trimmed, free heap memory is given back to
+ * the system, and the number of reads in flight is capped for a while, so
+ * that fewer result buffers are allocated at the same time.
+ *
+ * The cap is relative to the reads in flight when pressure began: many of
+ * them may be blocked on idle sockets, and counting them would let a few idle
+ * connections stall all the others. Only `maxNewReads` more are admitted.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+# include <malloc.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include <nan.h>
+#include <uv.h>
+
+#include "common.h"
+#include "memory-pressure.h"
+#include "rate-limit.h"
+
+// UV_PRIORITIZED (POLLPRI, which PSI triggers use) was added in libuv 1.14.0
+#if UV_VERSION_MAJOR > 1 || UV_VERSION_MINOR >= 14
+# define POLL_PRESSURE UV_PRIORITIZED
+#else
+# define POLL_PRESSURE 0
+#endif
+
+struct PressureWatch {
+    uv_poll_t handle;
+    uv_timer_t cooldown;
+    int open_handles;
+    int fd;
+    Nan::Callback *callback;
+
+    size_t max_new_reads;
+    uint64_t cooldown_ms;
+    bool gc;
+};
+
+static PressureWatch *watch;
+static std::vector<MemoryTrimmer> trimmers;
+
+static uint64_t events;
+static uint64_t reclaimed_bytes;
+static bool under_pressure;
+
+void AddMemoryTrimmer(MemoryTrimmer trimmer) {
+    trimmers.push_back(trimmer);
+}
+
+/*
+ * Resident set size, from /proc/self/statm. Returns 0 if unknown.
+ */
+static size_t ResidentBytes() {
+    unsigned long size, resident;
+
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (file == NULL)
+        return 0;
+    int n = fscanf(file, "%lu %lu", &size, &resident);
+    fclose(file);
+
+    return n == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+/*
+ * Open the pressure file of our cgroup, or of the whole system if cgroup v2
+ * is not in use, and register a trigger on it. Returns -1 in case of error.
+ */
+static int OpenPressureTrigger(uint64_t stall_us, uint64_t window_us) {
+    std::string path = "/proc/pressure/memory";
+
+    // On cgroup v2, /proc/self/cgroup has a single "0::<path>" line.
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    if (file != NULL) {
+        char line[4096];
+        while (fgets(line, sizeof(line), file)) {
+            if (strncmp(line, "0::", 3))
+                continue;
+            line[strcspn(line, "\n")] = '\0';
+            std::string cgroup = std::string("/sys/fs/cgroup") + &line[3] +
+                                 "/memory.pressure";
+            if (access(cgroup.c_str(), W_OK) == 0)
+                path = cgroup;
+            break;
+        }
+        fclose(file);
+    }
+
+    int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+
+    char trigger[64];
+    snprintf(trigger, sizeof(trigger), "some %llu %llu",
+             (unsigned long long) stall_us, (unsigned long long) window_us);
+    if (write(fd, trigger, strlen(trigger) + 1) == -1) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    return fd;
+}
+
+static void OnCooldownEnd(uv_timer_t *) {
+    under_pressure = false;
+    SetMaxReadsInFlight(0);
+}
+
+/*
+ * Give back as much memory as we can, and report it.
+ */
+static void HandlePressure(PressureWatch *watch) {
+    Nan::HandleScope scope;
+
+    events++;
+    if (!under_pressure)
+        SetMaxReadsInFlight(ReadsInFlight() + watch->max_new_reads);
+    under_pressure = true;
+    uv_timer_start(&watch->cooldown, OnCooldownEnd, watch->cooldown_ms, 0);
+
+    size_t before = ResidentBytes();
+    size_t trimmed = 0;
+    for (size_t i = 0; i < trimmers.size(); i++)
+        trimmed += trimmers[i]();
+    if (watch->gc)
+        Nan::LowMemoryNotification();
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    size_t after = ResidentBytes();
+    size_t reclaimed = before > after ? before - after : 0;
+    reclaimed_bytes += reclaimed;
+
+    v8::Local<v8::Object> event = Nan::New<v8::Object>();
+    event->Set(Nan::New<v8::String>("reclaimedBytes").ToLocalChecked(),
+               Nan::New<v8::Number>(reclaimed));
+    event->Set(Nan::New<v8::String>("trimmedPoolBytes").ToLocalChecked(),
+               Nan::New<v8::Number>(trimmed));
+
+    v8::Local<v8::Value> argv[] = { Nan::Null(), event };
+    watch->callback->Call(2, argv);
+}
+
+static void OnPressure(uv_poll_t *handle, int status, int /* events */) {
+    Nan::HandleScope scope;
+    PressureWatch *watch = reinterpret_cast<PressureWatch *>(handle->data);
+
+    if (status < 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "poll failed: %s", uv_strerror(status));
+        v8::Local<v8::Value> argv[] = {
+                ErrorWithProperty("systemError", msg) };
+        watch->callback->Call(1, argv);
+        return;
+    }
+
+    HandlePressure(watch);
+}
+
+static void OnWatchClosed(uv_handle_t *handle) {
+    PressureWatch *watch = reinterpret_cast<PressureWatch *>(handle->data);
+
+    if (--watch->open_handles > 0)
+        return;
+
+    close(watch->fd);
+    delete watch->callback;
+    delete watch;
+}
+
+static void CloseWatch(PressureWatch *watch) {
+    uv_timer_stop(&watch->cooldown);
+    uv_close(reinterpret_cast<uv_handle_t *>(&watch->cooldown),
+             OnWatchClosed);
+    if (watch->open_handles == 2) {
+        uv_poll_stop(&watch->handle);
+        uv_close(reinterpret_cast<uv_handle_t *>(&watch->handle),
+                 OnWatchClosed);
+    }
+}
+
+/*
+ * Get an optional non-negative integer option.
+ */
+static bool GetCountOption(v8::Local<v8::Object> options, const char *name,
+                           uint64_t default_value, uint64_t *value) {
+    v8::Local<v8::String> key = Nan::New<v8::String>(name).ToLocalChecked();
+
+    *value = default_value;
+    if (!options->Has(key))
+        return true;
+
+    v8::Local<v8::Value> option = options->Get(key);
+    if (!option->IsNumber())
+        return false;
+
+    double number = Nan::To<double>(option).FromJust();
+    if (number < 0 || number != static_cast<int64_t>(number))
+        return false;
+
+    *value = static_cast<uint64_t>(number);
+    return true;
+}
+
+NAN_METHOD(WatchMemoryPressure) {
+    if (info.Length() != 2) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'options' argument.
+     */
+    uint64_t stall_ms, window_ms, max_new_reads, cooldown_ms;
+    bool gc = false;
+    if (!info[0]->IsObject()) {
+        Nan::ThrowTypeError("first argument should be an object");
+        return;
+    }
+    v8::Local<v8::Object> options = info[0].As<v8::Object>();
+    v8::Local<v8::String> key = Nan::New<v8::String>("gc").ToLocalChecked();
+    if (options->Has(key))
+        gc = Nan::To<bool>(options->Get(key)).FromJust();
+
+    // PSI accepts windows from 500 ms to 10 s, and only multiples of 2 s
+    // from unprivileged processes.
+    if (!GetCountOption(options, "stallMs", 100, &stall_ms)
+            || !GetCountOption(options, "windowMs", 2000, &window_ms)
+            || !GetCountOption(options, "maxNewReads", 64, &max_new_reads)
+            || !GetCountOption(options, "cooldownMs", 10000, &cooldown_ms)
+            || max_new_reads == 0 || stall_ms == 0 || stall_ms > window_ms
+            || window_ms < 500 || window_ms > 10000) {
+        Nan::ThrowTypeError("first argument should be an object with valid "
+                            "options");
+        return;
+    }
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[1]->IsFunction()) {
+        Nan::ThrowTypeError("second argument should be a function");
+        return;
+    }
+
+    if (watch != NULL) {
+        Nan::ThrowError("memory pressure is already watched");
+        return;
+    }
+    if (POLL_PRESSURE == 0) {
+        Nan::ThrowError("cannot watch memory pressure: libuv is too old");
+        return;
+    }
+
+    int fd = OpenPressureTrigger(stall_ms * 1000, window_ms * 1000);
+    if (fd == -1) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "cannot watch memory pressure: %s",
+                 strerror(errno));
+        Nan::ThrowError(msg);
+        return;
+    }
+
+    watch = new PressureWatch();
+    watch->fd = fd;
+    watch->callback = new Nan::Callback(info[1].As<v8::Function>());
+    watch->max_new_reads = max_new_reads;
+    watch->cooldown_ms = cooldown_ms;
+    watch->gc = gc;
+    watch->handle.data = watch;
+    watch->cooldown.data = watch;
+
+    // Neither handle should keep the process alive.
+    uv_timer_init(Nan::GetCurrentEventLoop(), &watch->cooldown);
+    uv_unref(reinterpret_cast<uv_handle_t *>(&watch->cooldown));
+    watch->open_handles = 1;
+
+    int err = uv_poll_init(Nan::GetCurrentEventLoop(), &watch->handle, fd);
+    if (!err) {
+        watch->open_handles = 2;
+        err = uv_poll_start(&watch->handle, POLL_PRESSURE, OnPressure);
+    }
+    if (err) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "cannot poll pressure file: %s",
+                 uv_strerror(err));
+        Nan::ThrowError(msg);
+        CloseWatch(watch);
+        watch = NULL;
+        return;
+    }
+    uv_unref(reinterpret_cast<uv_handle_t *>(&watch->handle));
+}
+
+NAN_METHOD(UnwatchMemoryPressure) {
+    if (watch == NULL)
+        return;
+
+    CloseWatch(watch);
+    watch = NULL;
+
+    if (under_pressure)
+        OnCooldownEnd(NULL);
+}
+
+NAN_METHOD(MemoryPressureStats) {
+    v8::Local<v8::Object> stats = Nan::New<v8::Object>();
+
+    stats->Set(Nan::New<v8::String>("events").ToLocalChecked(),
+               Nan::New<v8::Number>(events));
+    stats->Set(Nan::New<v8::String>("reclaimedBytes").ToLocalChecked(),
+               Nan::New<v8::Number>(reclaimed_bytes));
+    stats->Set(Nan::New<v8::String>("underPressure").ToLocalChecked(),
+               Nan::New<v8::Boolean>(under_pressure));
+
+    info.GetReturnValue().Set(stats);
+}
+
+/*
+ * React as if the kernel had reported memory pressure, to test the reaction.
+ */
+NAN_METHOD(SimulateMemoryPressure) {
+    if (watch == NULL) {
+        Nan::ThrowError("memory pressure is not watched");
+        return;
+    }
+
+    HandlePressure(watch);
+}
@@ -23,9 +23,50 @@
 #include <nan.h>
 
 #include "posix-read.h"
+#include "read-worker.h"
 
 NAN_MODULE_INIT(Init) {
     NAN_EXPORT(target, Read);
+    NAN_EXPORT(target, ReadRanges);
+    NAN_EXPORT(target, Prefetch);
+    NAN_EXPORT(target, ReadRecords);
+    NAN_EXPORT(target, ReadUInt8);
+    NAN_EXPORT(target, ReadUInt16);
+    NAN_EXPORT(target, ReadUInt32);
+#if V8_MAJOR_VERSION >= 7
+    NAN_EXPORT(target, ReadBigUInt64);
+#endif
+    NAN_EXPORT(target, OnReadable);
+    NAN_EXPORT(target, SetFastErrors);
+    NAN_EXPORT(target, ReadFrames);
+    NAN_EXPORT(target, ReadFrame);
+    NAN_EXPORT(target, Listen);
+    NAN_EXPORT(target, CloseListener);
+    NAN_EXPORT(target, StartCapture);
+    NAN_EXPORT(target, StopCapture);
+    NAN_EXPORT(target, CaptureStats);
+    NAN_EXPORT(target, ReadAny);
+    NAN_EXPORT(target, ReadChunked);
+    NAN_EXPORT(target, ReadWebSocketFrame);
+    NAN_EXPORT(target, SetRateLimit);
+    NAN_EXPORT(target, SetRateLimitGroup);
+    NAN_EXPORT(target, RateLimitStats);
+    NAN_EXPORT(target, ForgetFd);
+    NAN_EXPORT(target, WatchMemoryPressure);
+    NAN_EXPORT(target, UnwatchMemoryPressure);
+    NAN_EXPORT(target, MemoryPressureStats);
+    NAN_EXPORT(target, SimulateMemoryPressure);
+    NAN_EXPORT(target, SetSmallResultPool);
+    NAN_EXPORT(target, EnableKtlsRx);
+    NAN_EXPORT(target, ReadMessages);
+    NAN_EXPORT(target, SeqpacketPair);
+    NAN_EXPORT(target, SetReaderPool);
+    NAN_EXPORT(target, ReaderPoolStats);
+    NAN_EXPORT(target, SetTransformPool);
+    NAN_EXPORT(target, TransformPoolStats);
+    NAN_EXPORT(target, TrackHeavyHitters);
+    NAN_EXPORT(target, SetHeavyHitterTag);
+    NAN_EXPORT(target, HeavyHitters);
 }
 
 NODE_MODULE(posix_read, Init);
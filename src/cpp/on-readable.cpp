@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include <nan.h>
+#include <uv.h>
+
+#include "common.h"
+
+// UV_DISCONNECT (POLLRDHUP) was added in libuv 1.9.0
+#if UV_VERSION_MAJOR > 1 || UV_VERSION_MINOR >= 9
+# define POLL_HANGUP UV_DISCONNECT
+#else
+# define POLL_HANGUP 0
+#endif
+
+/*
+ * A one-shot watch on a file descriptor. It lives in the event loop (not in a
+ * worker thread) and is freed as soon as it fired.
+ */
+struct ReadinessWatch {
+    uv_poll_t handle;
+    Nan::Callback *callback;
+};
+
+static void PollError(Nan::Callback *callback, int err) {
+    char msg[256];
+    snprintf(msg, sizeof(msg), "cannot poll socket: %s", uv_strerror(err));
+
+    v8::Local<v8::Value> argv[] = { ErrorWithProperty("badStream", msg) };
+    callback->Call(1, argv);
+}
+
+static void OnWatchClosed(uv_handle_t *handle) {
+    ReadinessWatch *watch = reinterpret_cast<ReadinessWatch *>(handle->data);
+
+    delete watch->callback;
+    delete watch;
+}
+
+static void OnWatchEvent(uv_poll_t *handle, int status, int events) {
+    Nan::HandleScope scope;
+    ReadinessWatch *watch = reinterpret_cast<ReadinessWatch *>(handle->data);
+
+    uv_poll_stop(handle);
+
+    if (status < 0) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "poll failed: %s", uv_strerror(status));
+        v8::Local<v8::Value> argv[] = {
+                ErrorWithProperty("systemError", msg) };
+        watch->callback->Call(1, argv);
+    } else {
+        v8::Local<v8::Object> result = Nan::New<v8::Object>();
+        result->Set(Nan::New<v8::String>("readable").ToLocalChecked(),
+                    Nan::New<v8::Boolean>((events & UV_READABLE) != 0));
+        result->Set(Nan::New<v8::String>("hangup").ToLocalChecked(),
+                    Nan::New<v8::Boolean>((events & POLL_HANGUP) != 0));
+        v8::Local<v8::Value> argv[] = { Nan::Null(), result };
+        watch->callback->Call(2, argv);
+    }
+
+    uv_close(reinterpret_cast<uv_handle_t *>(handle), OnWatchClosed);
+}
+
+/*
+ * Get the libuv events to watch from an `{ events: [...] }` object. Returns 0
+ * if the object is not well-formed.
+ */
+static int ParseEvents(v8::Local<v8::Value> value) {
+    if (!value->IsObject())
+        return 0;
+    v8::Local<v8::Object> options = value.As<v8::Object>();
+
+    v8::Local<v8::String> key = Nan::New<v8::String>("events")
+            .ToLocalChecked();
+    if (!options->Has(key))
+        return UV_READABLE | POLL_HANGUP;
+
+    v8::Local<v8::Value> events = options->Get(key);
+    if (!events->IsArray())
+        return 0;
+
+    int flags = 0;
+    v8::Local<v8::Array> array = events.As<v8::Array>();
+    for (uint32_t i = 0; i < array->Length(); i++) {
+        Nan::Utf8String event(array->Get(i));
+        if (!strcmp("readable", *event))
+            flags |= UV_READABLE;
+        else if (!strcmp("hangup", *event))
+            flags |= POLL_HANGUP;
+        else
+            return 0;
+    }
+
+    return flags;
+}
+
+NAN_METHOD(OnReadable) {
+    if (info.Length() != 3) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' argument.
+     */
+    if (!LooksLikeASocket(info[0])) {
+        Nan::ThrowTypeError("first argument should be a socket");
+        return;
+    }
+    v8::Local<v8::Object> socket = info[0].As<v8::Object>();
+
+    /*
+     * Get 'options' argument.
+     */
+    int events = ParseEvents(info[1]);
+    if (!events) {
+        Nan::ThrowTypeError("second argument should be an object with "
+                            "valid events");
+        return;
+    }
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[2]->IsFunction()) {
+        Nan::ThrowTypeError("third argument should be a function");
+        return;
+    }
+    Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
+
+    int fd = CheckSocket(socket, callback);
+    if (fd == -1)
+        return;
+
+    ReadinessWatch *watch = new ReadinessWatch();
+    watch->callback = callback;
+    watch->handle.data = watch;
+
+    // The fd belongs to the socket's own handle: libuv only allows one watcher
+    // per fd and loop, so this fails while Node reads from the socket (it is
+    // not paused) or has writes pending on it.
+    int err = uv_poll_init(Nan::GetCurrentEventLoop(), &watch->handle, fd);
+    if (err == UV_EEXIST) {
+        v8::Local<v8::Value> argv[] = { ErrorWithProperty("badStream",
+                "cannot poll socket: it is being read or written by Node "
+                "(pause it and wait for pending writes)") };
+        callback->Call(1, argv);
+        OnWatchClosed(reinterpret_cast<uv_handle_t *>(&watch->handle));
+        return;
+    } else if (err) {
+        PollError(callback, err);
+        OnWatchClosed(reinterpret_cast<uv_handle_t *>(&watch->handle));
+        return;
+    }
+
+    err = uv_poll_start(&watch->handle, events, OnWatchEvent);
+    if (err) {
+        PollError(callback, err);
+        uv_close(reinterpret_cast<uv_handle_t *>(&watch->handle),
+                 OnWatchClosed);
+        return;
+    }
+}
@@ -26,5 +26,44 @@
 #include <nan.h>
 
 NAN_METHOD(Read);
+NAN_METHOD(ReadRanges);
+NAN_METHOD(Prefetch);
+NAN_METHOD(ReadRecords);
+NAN_METHOD(ReadUInt8);
+NAN_METHOD(ReadUInt16);
+NAN_METHOD(ReadUInt32);
+#if V8_MAJOR_VERSION >= 7  // BigInt API
+NAN_METHOD(ReadBigUInt64);
+#endif
+NAN_METHOD(OnReadable);
+NAN_METHOD(ReadFrames);
+NAN_METHOD(ReadFrame);
+NAN_METHOD(Listen);
+NAN_METHOD(CloseListener);
+NAN_METHOD(StartCapture);
+NAN_METHOD(StopCapture);
+NAN_METHOD(CaptureStats);
+NAN_METHOD(ReadAny);
+NAN_METHOD(ReadChunked);
+NAN_METHOD(ReadWebSocketFrame);
+NAN_METHOD(SetRateLimit);
+NAN_METHOD(SetRateLimitGroup);
+NAN_METHOD(RateLimitStats);
+NAN_METHOD(ForgetFd);
+NAN_METHOD(WatchMemoryPressure);
+NAN_METHOD(UnwatchMemoryPressure);
+NAN_METHOD(MemoryPressureStats);
+NAN_METHOD(SimulateMemoryPressure);
+NAN_METHOD(SetSmallResultPool);
+NAN_METHOD(EnableKtlsRx);
+NAN_METHOD(ReadMessages);
+NAN_METHOD(SeqpacketPair);
+NAN_METHOD(SetReaderPool);
+NAN_METHOD(ReaderPoolStats);
+NAN_METHOD(SetTransformPool);
+NAN_METHOD(TransformPoolStats);
+NAN_METHOD(TrackHeavyHitters);
+NAN_METHOD(SetHeavyHitterTag);
+NAN_METHOD(HeavyHitters);
 
 #endif /* POSIX_READ_H */
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include <vector>
+
+#include <nan.h>
+
+#include "common.h"
+#include "read-worker.h"
+
+/*
+ * Ask the kernel to start loading a range of a file in the page cache. This
+ * does not wait for the data to be actually read.
+ */
+static int Advise(int fd, const FileRange &range) {
+#if defined(POSIX_FADV_WILLNEED)
+    return posix_fadvise(fd, range.offset, range.length, POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+    struct radvisory advice;
+    advice.ra_offset = range.offset;
+    advice.ra_count = range.length;
+    return fcntl(fd, F_RDADVISE, &advice) == -1 ? errno : 0;
+#else
+    return 0;
+#endif
+}
+
+class PrefetchWorker : public ReadWorker {
+ private:
+    int fd;
+
+    std::vector<FileRange> ranges;
+
+ public:
+    PrefetchWorker(Nan::Callback *callback, int fd,
+                   const std::vector<FileRange> &ranges)
+            : ReadWorker(callback), fd(fd), ranges(ranges) { }
+
+    ~PrefetchWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        for (const FileRange &range : ranges) {
+            int err = Advise(fd, range);
+            if (err) {
+                SetSystemError("fadvise", err);
+                return;
+            }
+        }
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        if (callback == NULL)
+            return;
+
+        v8::Local<v8::Value> argv[] = { Nan::Null() };
+        callback->Call(1, argv);
+    }
+
+    void HandleErrorCallback() {
+        if (callback == NULL)
+            return;
+
+        ReadWorker::HandleErrorCallback();
+    }
+};
+
+NAN_METHOD(Prefetch) {
+    if (info.Length() != 2 && info.Length() != 3) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'fd' argument.
+     */
+    if (!info[0]->IsNumber() || Nan::To<int>(info[0]).FromJust() < 0) {
+        Nan::ThrowTypeError("first argument should be a file descriptor");
+        return;
+    }
+    int fd = Nan::To<int>(info[0]).FromJust();
+
+    /*
+     * Get 'ranges' argument.
+     */
+    std::vector<FileRange> ranges;
+    if (!ParseRanges(info[1], &ranges)) {
+        Nan::ThrowTypeError("second argument should be an array of "
+                            "[offset, length] pairs");
+        return;
+    }
+
+    /*
+     * Get optional 'callback' argument.
+     */
+    Nan::Callback *callback = NULL;
+    if (info.Length() == 3) {
+        if (!info[2]->IsFunction()) {
+            Nan::ThrowTypeError("third argument should be a function");
+            return;
+        }
+        callback = new Nan::Callback(info[2].As<v8::Function>());
+    }
+
+    Nan::AsyncQueueWorker(new PrefetchWorker(callback, fd, ranges));
+    return;
+}
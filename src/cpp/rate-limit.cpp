@@ -0,0 +1,664 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Token-bucket rate limiting of reads, per fd and per named group of fds.
+ *
+ * A read is only queued to the threadpool if every bucket it depends on has
+ * a read token and no byte debt; otherwise it waits here, in order, and a
+ * timer retries when the buckets will have refilled enough. Bytes can't be
+ * known in advance for all reads (frames, chunked bodies...), so they are
+ * charged once consumed, as reported by the workers: a large read puts its
+ * bucket in debt and delays the next ones. Data left in the kernel meanwhile
+ * fills the socket receive buffer, and TCP slows the sender down.
+ *
+ * The same queues hold reads back when the number of reads in flight is capped
+ * (see SetMaxReadsInFlight()); they are then let through as others complete.
+ *
+ * They also keep the reads of each fd in order: only one at a time does I/O
+ * on a given fd. The next one is let through as soon as the previous one is
+ * done reading, even if its transform (see transform-pool.cpp) still runs, so
+ * that both overlap. Callbacks are delivered in the order reads were admitted:
+ * a read that overtakes a transform is held back until its turn.
+ *
+ * Limits and groups are keyed by fd: index.js drops them (ForgetFd()) right
+ * before the socket's fd is closed, so that the next socket to get the same
+ * fd doesn't inherit them. Waiting reads also remember the inode of their
+ * sockets, and are failed if the fd no longer refers to the same socket when
+ * their turn comes.
+ *
+ * Everything here runs on the main thread.
+ */
+
+#include <math.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <nan.h>
+
+#include "accounting.h"
+#include "common.h"
+#include "rate-limit.h"
+#include "reader-pool.h"
+
+struct TokenBucket {
+    double bytes_rate;   // per second, 0 if unlimited
+    double reads_rate;
+    double bytes_burst;
+    double reads_burst;
+    double bytes;        // tokens available, negative for a debt
+    double reads;
+    uint64_t updated;    // uv_hrtime() of the last refill
+};
+
+static std::map<int, TokenBucket> fd_limits;
+static std::map<std::string, TokenBucket> group_limits;
+static std::map<int, std::string> fd_groups;
+
+/*
+ * A read waiting for its buckets, queued under its first fd. It depends on
+ * the buckets of all its fds (several for readAny()).
+ */
+struct WaitingRead {
+    ReadWorker *worker;
+    std::vector<int> fds;
+    std::vector<ino_t> inodes;
+};
+
+static std::map<int, std::deque<WaitingRead> > waiting;
+static size_t waiting_reads;
+static uint64_t delayed_reads;
+
+// Waiting reads whose socket went away, failed from the timer callback rather
+// than from whatever call noticed it.
+static std::vector<ReadWorker *> aborted;
+
+static size_t in_flight;
+static size_t max_in_flight;  // 0 if unlimited
+
+// The read doing I/O on each fd, and the admitted reads of each fd that have
+// not called back yet, in order.
+static std::map<int, ReadWorker *> reading;
+static std::map<int, std::deque<ReadWorker *> > to_call_back;
+static uint64_t overlapped_reads;
+
+// Held reads of closed fds, called back from the timer callback.
+static std::vector<ReadWorker *> released;
+
+static uv_timer_t timer;
+static bool timer_initialized;
+static uint64_t timer_due;  // uv_hrtime() at which it fires, 0 if stopped
+
+static void Refill(TokenBucket *bucket, uint64_t now) {
+    double elapsed = (now - bucket->updated) / 1e9;
+    bucket->updated = now;
+
+    if (bucket->bytes_rate)
+        bucket->bytes = fmin(bucket->bytes_burst,
+                             bucket->bytes + elapsed * bucket->bytes_rate);
+    if (bucket->reads_rate)
+        bucket->reads = fmin(bucket->reads_burst,
+                             bucket->reads + elapsed * bucket->reads_rate);
+}
+
+/*
+ * Seconds until the bucket allows one more read.
+ */
+static double Delay(const TokenBucket &bucket) {
+    double delay = 0;
+
+    if (bucket.bytes_rate && bucket.bytes < 0)
+        delay = -bucket.bytes / bucket.bytes_rate;
+    if (bucket.reads_rate && bucket.reads < 1)
+        delay = fmax(delay, (1 - bucket.reads) / bucket.reads_rate);
+
+    return delay;
+}
+
+/*
+ * Add the buckets that reads on `fd` depend on, its own and its group's, to
+ * `buckets` (once each).
+ */
+static void GetBuckets(int fd, std::vector<TokenBucket *> *buckets) {
+    TokenBucket *found[2];
+    size_t count = 0;
+
+    std::map<int, TokenBucket>::iterator it = fd_limits.find(fd);
+    if (it != fd_limits.end())
+        found[count++] = &it->second;
+
+    std::map<int, std::string>::iterator group = fd_groups.find(fd);
+    if (group != fd_groups.end()) {
+        std::map<std::string, TokenBucket>::iterator limit =
+                group_limits.find(group->second);
+        if (limit != group_limits.end())
+            found[count++] = &limit->second;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        if (std::find(buckets->begin(), buckets->end(), found[i])
+                == buckets->end())
+            buckets->push_back(found[i]);
+}
+
+/*
+ * Charge the bytes consumed by workers since the last time.
+ */
+static void ChargeConsumed(uint64_t now) {
+    std::map<int, uint64_t> consumed;
+    AccountingDrain(&consumed);
+
+    for (std::map<int, uint64_t>::iterator it = consumed.begin();
+         it != consumed.end(); ++it) {
+        std::vector<TokenBucket *> buckets;
+        GetBuckets(it->first, &buckets);
+        for (size_t i = 0; i < buckets.size(); i++) {
+            Refill(buckets[i], now);
+            buckets[i]->bytes -= it->second;
+        }
+    }
+}
+
+/*
+ * Take a read token if all buckets of `fds` allow it. Returns 0 in that case,
+ * the number of seconds to wait, or HUGE_VAL if the read has to wait for
+ * another one to complete.
+ */
+static double TryAdmit(const std::vector<int> &fds, uint64_t now) {
+    if (max_in_flight && in_flight >= max_in_flight)
+        return HUGE_VAL;
+    for (size_t i = 0; i < fds.size(); i++)
+        if (reading.count(fds[i]))
+            return HUGE_VAL;
+
+    std::vector<TokenBucket *> buckets;
+    for (size_t i = 0; i < fds.size(); i++)
+        GetBuckets(fds[i], &buckets);
+    double delay = 0;
+
+    for (size_t i = 0; i < buckets.size(); i++) {
+        Refill(buckets[i], now);
+        delay = fmax(delay, Delay(*buckets[i]));
+    }
+    if (delay > 0)
+        return delay;
+
+    for (size_t i = 0; i < buckets.size(); i++)
+        buckets[i]->reads -= 1;
+
+    return 0;
+}
+
+/*
+ * Identity of the socket behind `fd`, to tell it from a later one reusing the
+ * same fd. Returns 0 if `fd` is not open.
+ */
+static ino_t SocketInode(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == -1 ? 0 : st.st_ino;
+}
+
+static bool SocketsStillOpen(const WaitingRead &read) {
+    for (size_t i = 0; i < read.fds.size(); i++)
+        if (SocketInode(read.fds[i]) != read.inodes[i])
+            return false;
+    return true;
+}
+
+static void Admit(ReadWorker *worker, const std::vector<int> &fds) {
+    worker->MarkAdmitted(fds);
+    in_flight++;
+
+    bool overlaps = false;
+    for (size_t i = 0; i < fds.size(); i++) {
+        std::deque<ReadWorker *> &previous = to_call_back[fds[i]];
+        if (!previous.empty() && previous.back()->TransformPending())
+            overlaps = true;
+        previous.push_back(worker);
+        reading[fds[i]] = worker;
+    }
+    if (overlaps)
+        overlapped_reads++;
+
+    if (ReaderPoolEnabled())
+        ReaderPoolQueue(worker);
+    else
+        Nan::AsyncQueueWorker(worker);
+}
+
+static void OnTimer(uv_timer_t *handle);
+
+static void ArmTimer(double delay) {
+    uint64_t now = uv_hrtime();
+    uint64_t due = now + (uint64_t) (delay * 1e9);
+    if (timer_due != 0 && timer_due <= due)
+        return;
+
+    if (!timer_initialized) {
+        uv_timer_init(uv_default_loop(), &timer);
+        timer_initialized = true;
+    }
+    timer_due = due;
+    uv_timer_start(&timer, OnTimer, (uint64_t) ceil(delay * 1e3), 0);
+}
+
+/*
+ * Queue the waiting reads that buckets allow now, in order for each fd, and
+ * arm the timer for the next ones.
+ */
+static void Dispatch() {
+    uint64_t now = uv_hrtime();
+    double next = HUGE_VAL;
+
+    ChargeConsumed(now);
+
+    std::map<int, std::deque<WaitingRead> >::iterator it = waiting.begin();
+    while (it != waiting.end()) {
+        std::deque<WaitingRead> &queue = it->second;
+        while (!queue.empty()) {
+            if (!SocketsStillOpen(queue.front())) {
+                aborted.push_back(queue.front().worker);
+                queue.pop_front();
+                waiting_reads--;
+                continue;
+            }
+            double delay = TryAdmit(queue.front().fds, now);
+            if (delay > 0) {
+                next = fmin(next, delay);
+                break;
+            }
+            Admit(queue.front().worker, queue.front().fds);
+            queue.pop_front();
+            waiting_reads--;
+        }
+
+        if (queue.empty())
+            waiting.erase(it++);
+        else
+            ++it;
+    }
+
+    if (!aborted.empty() || !released.empty())
+        next = 0;
+    if (next != HUGE_VAL)
+        ArmTimer(next);
+}
+
+void ReadCompleted() {
+    in_flight--;
+    if (!waiting.empty())
+        Dispatch();
+}
+
+size_t ReadsInFlight() {
+    return in_flight;
+}
+
+/*
+ * Called when `worker` is done with I/O, possibly before its transform: let
+ * the next read of its fds through.
+ */
+void ReadIoDone(ReadWorker *worker) {
+    const std::vector<int> &fds = worker->AdmittedFds();
+    for (size_t i = 0; i < fds.size(); i++) {
+        std::map<int, ReadWorker *>::iterator it = reading.find(fds[i]);
+        if (it != reading.end() && it->second == worker)
+            reading.erase(it);
+    }
+
+    if (!waiting.empty())
+        Dispatch();
+}
+
+/*
+ * Whether `worker` may call back: no read admitted before it on one of its
+ * fds is still to call back.
+ */
+bool ReadTurn(ReadWorker *worker) {
+    const std::vector<int> &fds = worker->AdmittedFds();
+    for (size_t i = 0; i < fds.size(); i++) {
+        std::map<int, std::deque<ReadWorker *> >::iterator it =
+                to_call_back.find(fds[i]);
+        if (it == to_call_back.end())
+            continue;
+        std::deque<ReadWorker *> &queue = it->second;
+        if (queue.front() != worker &&
+                std::find(queue.begin(), queue.end(), worker) != queue.end())
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Called right after `worker` called back: call back the reads that were
+ * held behind it, and are now first.
+ */
+void ReadCalledBack(ReadWorker *worker) {
+    std::vector<int> fds = worker->AdmittedFds();
+    for (size_t i = 0; i < fds.size(); i++) {
+        std::map<int, std::deque<ReadWorker *> >::iterator it =
+                to_call_back.find(fds[i]);
+        if (it == to_call_back.end())
+            continue;
+        std::deque<ReadWorker *> &queue = it->second;
+        std::deque<ReadWorker *>::iterator found =
+                std::find(queue.begin(), queue.end(), worker);
+        if (found != queue.end())
+            queue.erase(found);
+        if (queue.empty())
+            to_call_back.erase(it);
+    }
+
+    // Each callback may in turn release others: look again after each one.
+    for (bool progress = true; progress; ) {
+        progress = false;
+        for (size_t i = 0; i < fds.size() && !progress; i++) {
+            std::map<int, std::deque<ReadWorker *> >::iterator it =
+                    to_call_back.find(fds[i]);
+            if (it == to_call_back.end())
+                continue;
+            ReadWorker *next = it->second.front();
+            if (next->Held() && ReadTurn(next)) {
+                next->CallBack();
+                progress = true;
+            }
+        }
+    }
+}
+
+/*
+ * Cap the number of reads in flight (0 for no cap). Used to lower the
+ * admission of new reads, and so of new allocations, under memory pressure.
+ */
+void SetMaxReadsInFlight(size_t max_reads) {
+    max_in_flight = max_reads;
+    Dispatch();
+}
+
+static void OnTimer(uv_timer_t *) {
+    timer_due = 0;
+    Dispatch();
+
+    std::vector<ReadWorker *> workers;
+    workers.swap(aborted);
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i]->Abort("badStream", "socket was closed while the read was "
+                          "waiting");
+
+    // Their order no longer matters. Those also held on another fd are
+    // called back from there.
+    workers.swap(released);
+    for (size_t i = 0; i < workers.size(); i++)
+        if (workers[i]->Held() && ReadTurn(workers[i]))
+            workers[i]->CallBack();
+}
+
+/*
+ * Queue a worker reading from any of `fds` to the threadpool, now or when the
+ * rate limits of all of them allow it.
+ */
+void QueueReadWorker(const std::vector<int> &fds, ReadWorker *worker) {
+    for (size_t i = 0; i < fds.size(); i++)
+        AccountReadIssued(fds[i]);
+
+    bool busy = waiting.count(fds[0]) != 0;
+    for (size_t i = 0; i < fds.size(); i++)
+        busy = busy || reading.count(fds[i]);
+    if (!busy && fd_limits.empty() && group_limits.empty() && !max_in_flight) {
+        Admit(worker, fds);
+        return;
+    }
+
+    uint64_t now = uv_hrtime();
+    ChargeConsumed(now);
+
+    // Reads already waiting on the same (first) fd go first.
+    std::map<int, std::deque<WaitingRead> >::iterator it =
+            waiting.find(fds[0]);
+    double delay = it != waiting.end() ? 0 : TryAdmit(fds, now);
+    if (it == waiting.end() && delay == 0) {
+        Admit(worker, fds);
+        return;
+    }
+
+    WaitingRead read = { worker, fds, std::vector<ino_t>() };
+    for (size_t i = 0; i < fds.size(); i++)
+        read.inodes.push_back(SocketInode(fds[i]));
+    waiting[fds[0]].push_back(read);
+    waiting_reads++;
+    delayed_reads++;
+    if (delay > 0 && delay != HUGE_VAL)
+        ArmTimer(delay);
+}
+
+void QueueReadWorker(int fd, ReadWorker *worker) {
+    QueueReadWorker(std::vector<int>(1, fd), worker);
+}
+
+/*
+ * Get a positive rate option, 0 if absent. Returns false if it is something
+ * else.
+ */
+static bool GetRateOption(v8::Local<v8::Object> options, const char *name,
+                          double *value) {
+    v8::Local<v8::String> key = Nan::New<v8::String>(name).ToLocalChecked();
+
+    *value = 0;
+    if (!options->Has(key))
+        return true;
+
+    v8::Local<v8::Value> option = options->Get(key);
+    if (!option->IsNumber())
+        return false;
+
+    *value = Nan::To<double>(option).FromJust();
+    return *value > 0 && !isinf(*value);
+}
+
+/*
+ * Parse `{ bytesPerSecond, readsPerSecond, burstBytes, burstReads }`. Bursts
+ * default to one second worth of the rate.
+ */
+static bool ParseLimits(v8::Local<v8::Value> value, TokenBucket *bucket) {
+    if (!value->IsObject())
+        return false;
+    v8::Local<v8::Object> options = value.As<v8::Object>();
+
+    if (!GetRateOption(options, "bytesPerSecond", &bucket->bytes_rate)
+            || !GetRateOption(options, "readsPerSecond", &bucket->reads_rate)
+            || !GetRateOption(options, "burstBytes", &bucket->bytes_burst)
+            || !GetRateOption(options, "burstReads", &bucket->reads_burst))
+        return false;
+    if (!bucket->bytes_rate && !bucket->reads_rate)
+        return false;
+
+    if (!bucket->bytes_burst)
+        bucket->bytes_burst = bucket->bytes_rate;
+    if (!bucket->reads_burst)
+        bucket->reads_burst = fmax(1, bucket->reads_rate);
+
+    bucket->bytes = bucket->bytes_burst;
+    bucket->reads = bucket->reads_burst;
+    bucket->updated = uv_hrtime();
+    return true;
+}
+
+NAN_METHOD(SetRateLimit) {
+    if (info.Length() != 2) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'limits' argument.
+     */
+    TokenBucket bucket;
+    bool remove = info[1]->IsNull();
+    if (!remove && !ParseLimits(info[1], &bucket)) {
+        Nan::ThrowTypeError("second argument should be an object with valid "
+                            "limits, or null");
+        return;
+    }
+
+    /*
+     * Get 'target' argument: a socket, or a group name.
+     */
+    if (info[0]->IsString()) {
+        std::string group(*Nan::Utf8String(info[0]));
+        if (remove)
+            group_limits.erase(group);
+        else
+            group_limits[group] = bucket;
+    } else if (LooksLikeASocket(info[0])) {
+        int fd = GetFdFromSocket(info[0].As<v8::Object>());
+        if (fd == -1) {
+            Nan::ThrowTypeError("malformed socket object, cannot get file "
+                                "descriptor");
+            return;
+        }
+        if (remove)
+            fd_limits.erase(fd);
+        else
+            fd_limits[fd] = bucket;
+    } else {
+        Nan::ThrowTypeError("first argument should be a socket or a group "
+                            "name");
+        return;
+    }
+
+    AccountingEnable(!fd_limits.empty() || !group_limits.empty());
+
+    // Limits may have been lifted or relaxed for waiting reads.
+    Dispatch();
+    return;
+}
+
+NAN_METHOD(SetRateLimitGroup) {
+    if (info.Length() != 2) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' argument.
+     */
+    if (!LooksLikeASocket(info[0])) {
+        Nan::ThrowTypeError("first argument should be a socket");
+        return;
+    }
+    int fd = GetFdFromSocket(info[0].As<v8::Object>());
+    if (fd == -1) {
+        Nan::ThrowTypeError("malformed socket object, cannot get file "
+                            "descriptor");
+        return;
+    }
+
+    /*
+     * Get 'group' argument.
+     */
+    if (info[1]->IsNull()) {
+        fd_groups.erase(fd);
+    } else if (info[1]->IsString()) {
+        fd_groups[fd] = *Nan::Utf8String(info[1]);
+    } else {
+        Nan::ThrowTypeError("second argument should be a group name, or "
+                            "null");
+        return;
+    }
+
+    Dispatch();
+    return;
+}
+
+NAN_METHOD(RateLimitStats) {
+    v8::Local<v8::Object> stats = Nan::New<v8::Object>();
+
+    stats->Set(Nan::New<v8::String>("delayedReads").ToLocalChecked(),
+               Nan::New<v8::Number>(delayed_reads));
+    stats->Set(Nan::New<v8::String>("waitingReads").ToLocalChecked(),
+               Nan::New<v8::Number>(waiting_reads));
+    stats->Set(Nan::New<v8::String>("readsInFlight").ToLocalChecked(),
+               Nan::New<v8::Number>(in_flight));
+    stats->Set(Nan::New<v8::String>("overlappedReads").ToLocalChecked(),
+               Nan::New<v8::Number>(overlapped_reads));
+
+    info.GetReturnValue().Set(stats);
+}
+
+/*
+ * Called right before the socket behind `fd` is closed: drop its limits and
+ * group, and fail the reads waiting on it.
+ */
+NAN_METHOD(ForgetFd) {
+    if (info.Length() != 1 || !info[0]->IsNumber()
+            || Nan::To<int>(info[0]).FromJust() < 0) {
+        Nan::ThrowTypeError("first argument should be a file descriptor");
+        return;
+    }
+    int fd = Nan::To<int>(info[0]).FromJust();
+
+    fd_limits.erase(fd);
+    fd_groups.erase(fd);
+    HeavyHittersSetTag(fd, NULL);
+    AccountingEnable(!fd_limits.empty() || !group_limits.empty());
+
+    std::map<int, std::deque<WaitingRead> >::iterator it = waiting.begin();
+    while (it != waiting.end()) {
+        std::deque<WaitingRead> &queue = it->second;
+        for (size_t i = 0; i < queue.size(); ) {
+            if (std::find(queue[i].fds.begin(), queue[i].fds.end(), fd)
+                    == queue[i].fds.end()) {
+                i++;
+                continue;
+            }
+            aborted.push_back(queue[i].worker);
+            queue.erase(queue.begin() + i);
+            waiting_reads--;
+        }
+
+        if (queue.empty())
+            waiting.erase(it++);
+        else
+            ++it;
+    }
+
+    // Reads admitted on the fd no longer keep the next socket to get it
+    // waiting.
+    reading.erase(fd);
+    std::map<int, std::deque<ReadWorker *> >::iterator order =
+            to_call_back.find(fd);
+    if (order != to_call_back.end()) {
+        for (size_t i = 0; i < order->second.size(); i++)
+            if (order->second[i]->Held())
+                released.push_back(order->second[i]);
+        to_call_back.erase(order);
+    }
+
+    // Fail them from the timer, not from within the socket's close().
+    if (!aborted.empty() || !released.empty())
+        ArmTimer(0);
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef RATE_LIMIT_H
+# define RATE_LIMIT_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "read-worker.h"
+
+void QueueReadWorker(int fd, ReadWorker *worker);
+void QueueReadWorker(const std::vector<int> &fds, ReadWorker *worker);
+void ReadIoDone(ReadWorker *worker);
+bool ReadTurn(ReadWorker *worker);
+void ReadCalledBack(ReadWorker *worker);
+void ReadCompleted();
+size_t ReadsInFlight();
+void SetMaxReadsInFlight(size_t max_reads);
+
+#endif /* RATE_LIMIT_H */
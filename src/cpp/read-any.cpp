@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <set>
+#include <vector>
+
+#include <nan.h>
+
+#include "common.h"
+#include "io.h"
+#include "rate-limit.h"
+#include "read-worker.h"
+#include "slab.h"
+
+#ifdef POLLRDHUP
+# define POLL_HANGUP (POLLHUP | POLLERR | POLLRDHUP)
+#else
+# define POLLRDHUP 0
+# define POLL_HANGUP (POLLHUP | POLLERR)
+#endif
+
+/*
+ * Fds whose SO_RCVLOWAT is currently raised by a readAny(). A second one on
+ * the same socket would save the raised value as the one to restore, and put
+ * it back after the first one restored the original: it is refused instead.
+ * Claimed and released from worker threads.
+ */
+static pthread_mutex_t lowat_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::set<int> lowat_owners;
+
+static bool ClaimLowWaterMark(int fd) {
+    pthread_mutex_lock(&lowat_lock);
+    bool claimed = lowat_owners.insert(fd).second;
+    pthread_mutex_unlock(&lowat_lock);
+    return claimed;
+}
+
+static void ReleaseLowWaterMark(int fd) {
+    pthread_mutex_lock(&lowat_lock);
+    lowat_owners.erase(fd);
+    pthread_mutex_unlock(&lowat_lock);
+}
+
+class ReadAnyWorker : public ReadWorker {
+ private:
+    std::vector<int> fds;
+    std::vector<bool> claimed;  // fds whose low-water mark this one owns
+    bool fd_was_non_blocking;
+
+    size_t size;
+    char *data;
+
+    int index;  // position of the winning socket, or -1
+
+    /*
+     * Wait until one of the sockets has `size` bytes queued, or reaches its
+     * end before. Sockets earlier in the array win ties.
+     */
+    bool WaitForAny() {
+        std::vector<struct pollfd> pfds(fds.size());
+        for (size_t i = 0; i < fds.size(); i++) {
+            pfds[i].fd = fds[i];
+            pfds[i].events = POLLIN | POLLRDHUP;
+        }
+
+        for (;;) {
+            if (poll(&pfds[0], pfds.size(), -1) == -1) {
+                if (errno == EINTR)
+                    continue;
+                SetSystemError("poll", errno);
+                return false;
+            }
+
+            // With the low-water mark in place, a socket is only reported
+            // once it has `size` bytes queued, or on its end or an error.
+            for (size_t i = 0; i < pfds.size(); i++) {
+                if (!pfds[i].revents)
+                    continue;
+
+                index = i;
+                if (pfds[i].revents & POLLNVAL) {
+                    SetSystemError("poll", EBADF);
+                    return false;
+                }
+
+                int available;
+                if (ioctl(fds[i], FIONREAD, &available) == -1) {
+                    SetSystemError("ioctl", errno);
+                    return false;
+                }
+                if ((size_t) available >= size)
+                    return true;
+                if (pfds[i].revents & POLL_HANGUP) {
+                    SetEndOfFile(available);
+                    return false;
+                }
+            }
+            index = -1;
+        }
+    }
+
+    /*
+     * With SO_RCVLOWAT, TCP sockets are only reported readable once `size`
+     * bytes are queued, so that the wait doesn't wake up on every segment.
+     * Other socket types ignore it, and the kernel caps it to what the
+     * receive buffer can hold: both would make poll() return early again and
+     * again, so they are refused. Previous values are saved in `lowats`.
+     * Sockets already waited on by another readAny() (or listed twice) are
+     * refused too, see ClaimLowWaterMark().
+     */
+    bool SetLowWaterMarks(std::vector<int> *lowats) {
+        int lowat = size > 0x7fffffff ? 0x7fffffff : (int) size;
+
+        for (size_t i = 0; i < fds.size(); i++) {
+            struct sockaddr_storage addr;
+            socklen_t len = sizeof(addr);
+            if (getsockname(fds[i], (struct sockaddr *) &addr, &len) == -1) {
+                SetSystemError("getsockname", errno);
+                index = i;
+                return false;
+            }
+            if (addr.ss_family != AF_INET && addr.ss_family != AF_INET6) {
+                SetError("badStream", "readAny() only supports TCP sockets");
+                index = i;
+                return false;
+            }
+
+            if (!ClaimLowWaterMark(fds[i])) {
+                SetError("badStream", "socket is already waited on by "
+                         "readAny()");
+                index = i;
+                return false;
+            }
+            claimed[i] = true;
+
+            int effective;
+            len = sizeof(effective);
+            if (getsockopt(fds[i], SOL_SOCKET, SO_RCVLOWAT, &(*lowats)[i],
+                           &len)
+                    || setsockopt(fds[i], SOL_SOCKET, SO_RCVLOWAT, &lowat,
+                                  sizeof(lowat))
+                    || getsockopt(fds[i], SOL_SOCKET, SO_RCVLOWAT, &effective,
+                                  &len)) {
+                SetSystemError("setsockopt", errno);
+                index = i;
+                return false;
+            }
+            if (effective < lowat) {
+                SetError("badStream", "size is larger than the socket can "
+                         "queue (%llu bytes)", effective);
+                index = i;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+ public:
+    ReadAnyWorker(Nan::Callback *callback, const std::vector<int> &fds,
+                  size_t size)
+            : ReadWorker(callback), fds(fds), claimed(fds.size(), false),
+              size(size), index(-1) { }
+
+    ~ReadAnyWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        std::vector<int> lowats(fds.size(), -1);
+        bool ready = SetLowWaterMarks(&lowats) && WaitForAny();
+
+        // Restore before releasing, so that the next owner saves the
+        // original value.
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (lowats[i] != -1)
+                setsockopt(fds[i], SOL_SOCKET, SO_RCVLOWAT, &lowats[i],
+                           sizeof(lowats[i]));
+            if (claimed[i])
+                ReleaseLowWaterMark(fds[i]);
+        }
+
+        if (!ready)
+            return;
+
+        int fd = fds[index];
+
+        data = reinterpret_cast<char *>(malloc(size));
+        if (data == NULL) {
+            SetSystemError("malloc", errno);
+            return;
+        }
+
+        if (SetBlocking(fd, &fd_was_non_blocking)) {
+            SetSystemError("fcntl", errno);
+            free(data);
+            return;
+        }
+
+        ssize_t count = ReadExactly(fd, data, size);
+        if (count == -1) {
+            SetSystemError("read", errno);
+            free(data);
+        } else if ((size_t) count < size) {  // end of stream
+            SetEndOfFile(count);
+            free(data);
+        }
+
+        if (UnsetBlocking(fd, fd_was_non_blocking)) {
+            if (!HasError()) {
+                SetSystemError("fcntl", errno);
+                free(data);
+            }
+        }
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        v8::Local<v8::Object> buffer;
+        if (IsSmallResult(size)) {
+            buffer = NewSmallBuffer(data, size);
+            free(data);
+        } else {
+            buffer = Nan::NewBuffer(data, (uint32_t) size).ToLocalChecked();
+        }
+
+        v8::Local<v8::Value> argv[] = { Nan::Null(), buffer,
+                                        Nan::New<v8::Integer>(index) };
+        callback->Call(3, argv);
+    }
+
+    /*
+     * Also tell which socket failed, when the error is about one of them.
+     */
+    void HandleErrorCallback() {
+        Nan::HandleScope scope;
+
+        if (index == -1) {
+            ReadWorker::HandleErrorCallback();
+            return;
+        }
+
+        v8::Local<v8::Value> argv[] = { NewError(), Nan::Null(),
+                                        Nan::New<v8::Integer>(index) };
+        callback->Call(3, argv);
+    }
+};
+
+NAN_METHOD(ReadAny) {
+    if (info.Length() != 3) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'sockets' argument.
+     */
+    if (!info[0]->IsArray() || info[0].As<v8::Array>()->Length() == 0) {
+        Nan::ThrowTypeError("first argument should be an array of sockets");
+        return;
+    }
+    v8::Local<v8::Array> sockets = info[0].As<v8::Array>();
+    for (uint32_t i = 0; i < sockets->Length(); i++) {
+        if (!LooksLikeASocket(sockets->Get(i))) {
+            Nan::ThrowTypeError("first argument should be an array of "
+                                "sockets");
+            return;
+        }
+    }
+
+    /*
+     * Get 'size' argument.
+     */
+    if (!info[1]->IsNumber() || Nan::To<int>(info[1]).FromJust() <= 0) {
+        Nan::ThrowTypeError("second argument should be a positive integer");
+        return;
+    }
+    size_t size = Nan::To<int>(info[1]).FromJust();
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[2]->IsFunction()) {
+        Nan::ThrowTypeError("third argument should be a function");
+        return;
+    }
+    Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
+
+    /*
+     * Run-time checks. They don't throw (since these are not programmer errors)
+     * but callback(error).
+     */
+    std::vector<int> fds;
+    for (uint32_t i = 0; i < sockets->Length(); i++) {
+        int fd = CheckSocket(sockets->Get(i).As<v8::Object>(), callback);
+        if (fd == -1)
+            return;
+        fds.push_back(fd);
+    }
+
+    QueueReadWorker(fds, new ReadAnyWorker(callback, fds, size));
+    return;
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <vector>
+
+#include <nan.h>
+
+#include "accounting.h"
+#include "chunked.h"
+#include "common.h"
+#include "io.h"
+#include "rate-limit.h"
+#include "read-worker.h"
+
+// First size of the buffer, which then doubles as the body is decoded.
+#define INITIAL_CAPACITY 4096
+
+class ReadChunkedWorker : public ReadWorker {
+ private:
+    int fd;
+    bool fd_was_non_blocking;
+
+    size_t max_bytes;
+    bool as_chunks;
+
+    ChunkedDecoder decoder;
+    std::vector<FrameSpan> chunks;
+    std::vector<FrameSpan> trailers;
+    size_t size;
+    size_t body_size;
+    char *data;
+    size_t capacity;
+
+    /*
+     * Add spans found by ChunkedFeed() at `base` in the raw data, merging
+     * the pieces of a chunk that arrived in several reads.
+     */
+    static void AddSpans(std::vector<FrameSpan> *spans,
+                         const std::vector<FrameSpan> &found, size_t base) {
+        for (size_t i = 0; i < found.size(); i++) {
+            size_t offset = base + found[i].offset;
+            if (!spans->empty() &&
+                    spans->back().offset + spans->back().length == offset) {
+                spans->back().length += found[i].length;
+            } else {
+                FrameSpan span = { offset, found[i].length };
+                spans->push_back(span);
+            }
+        }
+    }
+
+    /*
+     * Make room after the `size` bytes decoded so far: double the buffer,
+     * or more if the current chunk is known to need it, up to `max_bytes`.
+     */
+    bool Grow() {
+        size_t wanted = capacity ? 2 * capacity : INITIAL_CAPACITY;
+        if (decoder.state == CHUNKED_DATA &&
+                decoder.chunk_size < max_bytes - size &&
+                wanted < size + decoder.chunk_size)
+            wanted = size + decoder.chunk_size;
+        if (wanted > max_bytes)
+            wanted = max_bytes;
+
+        char *grown = reinterpret_cast<char *>(realloc(data, wanted));
+        if (grown == NULL) {
+            SetSystemError("malloc", errno);
+            return false;
+        }
+        data = grown;
+        capacity = wanted;
+        return true;
+    }
+
+    /*
+     * Peek what is queued, decode it, and consume exactly the bytes that
+     * belong to the body, until its end. The buffer grows as the body is
+     * decoded, rather than being allocated for `max_bytes` upfront.
+     */
+    void ReadBody() {
+        std::vector<FrameSpan> found_chunks, found_trailers;
+
+        size = 0;
+        while (decoder.state != CHUNKED_DONE) {
+            if (size == max_bytes) {
+                SetError("bodyTooLarge", "chunked body too large (more than "
+                         "%llu bytes)", max_bytes);
+                return;
+            }
+            if (size == capacity && !Grow())
+                return;
+
+            // ReadExactly() accounts for its own waits, but not this one.
+            uint64_t start = AccountingClock();
+            ssize_t n = Peek(fd, &data[size], capacity - size, 0);
+            AccountBlocked(fd, start);
+            if (n == -1) {
+                SetSystemError("recv", errno);
+                return;
+            } else if (n == 0) {
+                SetEndOfFile(size);
+                return;
+            }
+
+            found_chunks.clear();
+            found_trailers.clear();
+            ssize_t length = ChunkedFeed(&decoder, &data[size], n,
+                                         &found_chunks, &found_trailers);
+            if (length == -1) {
+                SetError("badChunk", "invalid chunked encoding");
+                return;
+            }
+
+            // These are the bytes we just decoded: read them for real.
+            ssize_t count = ReadExactly(fd, &data[size], length);
+            if (count == -1) {
+                SetSystemError("read", errno);
+                return;
+            } else if (count < length) {  // end of stream
+                SetEndOfFile(size + count);
+                return;
+            }
+
+            AddSpans(&chunks, found_chunks, size);
+            AddSpans(&trailers, found_trailers, size);
+            size += length;
+
+            // Don't wait for a chunk that could not fit anyway.
+            if (decoder.state == CHUNKED_DATA &&
+                    decoder.chunk_size > max_bytes - size) {
+                SetError("bodyTooLarge", "chunked body too large (more than "
+                         "%llu bytes)", max_bytes);
+                return;
+            }
+        }
+    }
+
+ public:
+    ReadChunkedWorker(Nan::Callback *callback, int fd, size_t max_bytes,
+                      bool as_chunks)
+            : ReadWorker(callback), fd(fd), max_bytes(max_bytes),
+              as_chunks(as_chunks) { }
+
+    ~ReadChunkedWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        data = NULL;
+        capacity = 0;
+
+        if (SetBlocking(fd, &fd_was_non_blocking)) {
+            SetSystemError("fcntl", errno);
+            return;
+        }
+
+        ReadBody();
+        if (HasError())
+            free(data);
+
+        if (UnsetBlocking(fd, fd_was_non_blocking)) {
+            if (!HasError()) {
+                SetSystemError("fcntl", errno);
+                free(data);
+            }
+        }
+
+        if (HasError())
+            return;
+
+        /*
+         * Unless chunks are wanted separately, move their data together at
+         * the beginning. Trailers come after all of it, so they stay where
+         * they are.
+         */
+        body_size = 0;
+        if (!as_chunks) {
+            for (size_t i = 0; i < chunks.size(); i++) {
+                memmove(&data[body_size], &data[chunks[i].offset],
+                        chunks[i].length);
+                body_size += chunks[i].length;
+            }
+        }
+
+        if (size < capacity) {
+            char *shrunk = reinterpret_cast<char *>(realloc(data, size));
+            if (shrunk != NULL)
+                data = shrunk;
+        }
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        v8::Local<v8::Object> buffer =
+                Nan::NewBuffer(data, (uint32_t) size).ToLocalChecked();
+
+        v8::Local<v8::Value> body;
+        if (as_chunks) {
+            v8::Local<v8::Array> views = Nan::New<v8::Array>(chunks.size());
+            for (size_t i = 0; i < chunks.size(); i++)
+                views->Set(i, NewBufferView(buffer, chunks[i].offset,
+                                            chunks[i].length));
+            body = views;
+        } else {
+            body = NewBufferView(buffer, 0, body_size);
+        }
+
+        // The trailer section is one contiguous span, if any.
+        v8::Local<v8::Object> trailer_section = trailers.empty() ?
+                NewBufferView(buffer, size, 0) :
+                NewBufferView(buffer, trailers[0].offset, trailers[0].length);
+
+        v8::Local<v8::Value> argv[] = { Nan::Null(), body, trailer_section };
+        callback->Call(3, argv);
+    }
+};
+
+/*
+ * Get the `chunks` option: absent (false) or a boolean. Returns false if it
+ * is something else.
+ */
+static bool GetChunksOption(v8::Local<v8::Object> options, bool *as_chunks) {
+    v8::Local<v8::String> key = Nan::New<v8::String>("chunks")
+            .ToLocalChecked();
+
+    *as_chunks = false;
+    if (!options->Has(key))
+        return true;
+
+    v8::Local<v8::Value> value = options->Get(key);
+    if (!value->IsBoolean())
+        return false;
+
+    *as_chunks = Nan::To<bool>(value).FromJust();
+    return true;
+}
+
+NAN_METHOD(ReadChunked) {
+    if (info.Length() != 3) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' argument.
+     */
+    if (!LooksLikeASocket(info[0])) {
+        Nan::ThrowTypeError("first argument should be a socket");
+        return;
+    }
+    v8::Local<v8::Object> socket = info[0].As<v8::Object>();
+
+    /*
+     * Get 'options' argument.
+     */
+    size_t max_bytes;
+    bool as_chunks;
+    if (!info[1]->IsObject()
+            || !GetSizeOption(info[1].As<v8::Object>(), "maxBytes",
+                              16 * 1024 * 1024, &max_bytes)
+            || !GetChunksOption(info[1].As<v8::Object>(), &as_chunks)) {
+        Nan::ThrowTypeError("second argument should be an object with valid "
+                            "options");
+        return;
+    }
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[2]->IsFunction()) {
+        Nan::ThrowTypeError("third argument should be a function");
+        return;
+    }
+    Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
+
+    int fd = CheckSocket(socket, callback);
+    if (fd == -1)
+        return;
+
+    QueueReadWorker(fd, new ReadChunkedWorker(callback, fd, max_bytes,
+                                                as_chunks));
+    return;
+}
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <nan.h>
+#include <node_buffer.h>
+
+#include "aead.h"
+#include "common.h"
+#include "frames.h"
+#include "io.h"
+#include "lz4.h"
+#include "rate-limit.h"
+#include "read-worker.h"
+#include "slab.h"
+
+enum Compression {
+    COMPRESSION_NONE,
+    COMPRESSION_LZ4,
+};
+
+/*
+ * Reads exactly one length-prefixed frame and, if asked, decrypts and
+ * decompresses its payload in the worker thread.
+ */
+class ReadFrameWorker : public ReadWorker {
+ private:
+    int fd;
+    bool fd_was_non_blocking;
+
+    PrefixSpec prefix;
+    size_t max_bytes;
+    AeadKey key;
+    Compression compression;
+
+    size_t size;
+    char *data;
+    size_t offset;
+    size_t length;
+
+    /*
+     * Read the whole frame, prefix included. The prefix is only peeked first,
+     * so that a frame that is too large is not consumed at all.
+     */
+    void ReadFrame() {
+        char bytes[4];
+
+        ssize_t count = PeekExactly(fd, bytes, prefix.size);
+        if (count == -1) {
+            SetSystemError("recv", errno);
+            return;
+        } else if ((size_t) count < prefix.size) {
+            SetEndOfFile(0);
+            return;
+        }
+
+        uint64_t payload = DecodePrefix(prefix, bytes);
+        if (payload > max_bytes) {
+            SetError("frameTooLarge", "frame too large (%llu bytes)",
+                     prefix.size + payload);
+            return;
+        }
+
+        size = prefix.size + payload;
+        data = reinterpret_cast<char *>(malloc(size));
+        if (data == NULL) {
+            SetSystemError("malloc", errno);
+            return;
+        }
+
+        count = ReadExactly(fd, data, size);
+        if (count == -1) {
+            SetSystemError("read", errno);
+            free(data);
+            return;
+        } else if ((size_t) count < size) {  // end of stream
+            SetEndOfFile(count);
+            free(data);
+            return;
+        }
+
+        offset = prefix.size;
+        length = payload;
+    }
+
+    /*
+     * The payload is a nonce, the ciphertext and a tag. The length prefix is
+     * authenticated too.
+     */
+    void Decrypt() {
+        ssize_t n = AeadDecrypt(key, data, prefix.size, &data[offset],
+                                length);
+        if (n == -1) {
+            SetError("authFailed", "frame authentication failed");
+            free(data);
+            return;
+        }
+
+        offset += AEAD_NONCE_SIZE;
+        length = n;
+    }
+
+    /*
+     * The payload is a 4-byte little-endian decompressed size, followed by an
+     * LZ4 block.
+     */
+    void DecompressLz4() {
+        if (length < 4) {
+            SetError("badFrame", "invalid LZ4 frame");
+            free(data);
+            return;
+        }
+
+        PrefixSpec header = { 4, false };
+        uint64_t decompressed_size = DecodePrefix(header, &data[offset]);
+        if (decompressed_size > max_bytes) {
+            SetError("frameTooLarge", "frame too large (%llu bytes)",
+                     decompressed_size);
+            free(data);
+            return;
+        }
+
+        char *decompressed = reinterpret_cast<char *>(
+                malloc(decompressed_size ? decompressed_size : 1));
+        if (decompressed == NULL) {
+            SetSystemError("malloc", errno);
+            free(data);
+            return;
+        }
+
+        ssize_t n = Lz4DecompressBlock(&data[offset + 4], length - 4,
+                                       decompressed, decompressed_size);
+        free(data);
+        if (n != (ssize_t) decompressed_size) {
+            SetError("badFrame", "invalid LZ4 frame");
+            free(decompressed);
+            return;
+        }
+
+        data = decompressed;
+        size = decompressed_size;
+        offset = 0;
+        length = decompressed_size;
+    }
+
+ public:
+    ReadFrameWorker(Nan::Callback *callback, int fd, PrefixSpec prefix,
+                    size_t max_bytes, const AeadKey &key,
+                    Compression compression)
+            : ReadWorker(callback), fd(fd), prefix(prefix),
+              max_bytes(max_bytes), key(key), compression(compression) { }
+
+    ~ReadFrameWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        if (SetBlocking(fd, &fd_was_non_blocking)) {
+            SetSystemError("fcntl", errno);
+            return;
+        }
+
+        ReadFrame();
+
+        if (UnsetBlocking(fd, fd_was_non_blocking)) {
+            if (!HasError()) {
+                SetSystemError("fcntl", errno);
+                free(data);
+            }
+        }
+
+        if (!HasError() && (key.algorithm != AEAD_NONE
+                            || compression != COMPRESSION_NONE)
+                && !DeferTransform(length))
+            Transform();
+    }
+
+    void Transform() {
+        if (key.algorithm != AEAD_NONE)
+            Decrypt();
+        if (!HasError() && compression == COMPRESSION_LZ4)
+            DecompressLz4();
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        v8::Local<v8::Object> buffer;
+        if (IsSmallResult(length)) {
+            buffer = NewSmallBuffer(&data[offset], length);
+            free(data);
+        } else {
+            buffer = Nan::NewBuffer(data, (uint32_t) size).ToLocalChecked();
+            if (offset != 0 || length != size)
+                buffer = NewBufferView(buffer, offset, length);
+        }
+
+        v8::Local<v8::Value> argv[] = { Nan::Null(), buffer };
+        callback->Call(2, argv);
+    }
+};
+
+/*
+ * Get the `decompress` option: absent, or 'lz4'. Returns false if it is
+ * something else.
+ */
+static bool GetCompressionOption(v8::Local<v8::Object> options,
+                                 Compression *compression) {
+    v8::Local<v8::String> key = Nan::New<v8::String>("decompress")
+            .ToLocalChecked();
+
+    *compression = COMPRESSION_NONE;
+    if (!options->Has(key))
+        return true;
+
+    v8::Local<v8::Value> value = options->Get(key);
+    if (!value->IsString())
+        return false;
+
+    if (!strcmp("lz4", *Nan::Utf8String(value))) {
+        *compression = COMPRESSION_LZ4;
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Get the `decrypt` option: absent, or `{ algorithm, key }` with a supported
+ * algorithm and a 32-byte key. Returns false if it is something else.
+ */
+static bool GetDecryptOption(v8::Local<v8::Object> options, AeadKey *key) {
+    v8::Local<v8::String> name = Nan::New<v8::String>("decrypt")
+            .ToLocalChecked();
+
+    key->algorithm = AEAD_NONE;
+    if (!options->Has(name))
+        return true;
+
+    v8::Local<v8::Value> value = options->Get(name);
+    if (!value->IsObject())
+        return false;
+    v8::Local<v8::Object> decrypt = value.As<v8::Object>();
+
+    Nan::Utf8String algorithm(decrypt->Get(
+            Nan::New<v8::String>("algorithm").ToLocalChecked()));
+    if (!strcmp("aes-256-gcm", *algorithm))
+        key->algorithm = AEAD_AES_256_GCM;
+    else if (!strcmp("chacha20-poly1305", *algorithm))
+        key->algorithm = AEAD_CHACHA20_POLY1305;
+    else
+        return false;
+    if (!AeadAlgorithmSupported(key->algorithm))
+        return false;
+
+    v8::Local<v8::Value> buffer = decrypt->Get(
+            Nan::New<v8::String>("key").ToLocalChecked());
+    if (!node::Buffer::HasInstance(buffer)
+            || node::Buffer::Length(buffer) != AEAD_KEY_SIZE)
+        return false;
+    memcpy(key->key, node::Buffer::Data(buffer), AEAD_KEY_SIZE);
+
+    return true;
+}
+
+NAN_METHOD(ReadFrame) {
+    if (info.Length() != 4) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' argument.
+     */
+    if (!LooksLikeASocket(info[0])) {
+        Nan::ThrowTypeError("first argument should be a socket");
+        return;
+    }
+    v8::Local<v8::Object> socket = info[0].As<v8::Object>();
+
+    /*
+     * Get 'prefix' argument.
+     */
+    PrefixSpec prefix;
+    if (!ParsePrefixSpec(info[1], &prefix)) {
+        Nan::ThrowTypeError("second argument should be a prefix type");
+        return;
+    }
+
+    /*
+     * Get 'options' argument.
+     */
+    size_t max_bytes;
+    AeadKey key;
+    Compression compression;
+    if (!info[2]->IsObject()
+            || !GetSizeOption(info[2].As<v8::Object>(), "maxBytes",
+                              16 * 1024 * 1024, &max_bytes)
+            || !GetDecryptOption(info[2].As<v8::Object>(), &key)
+            || !GetCompressionOption(info[2].As<v8::Object>(),
+                                     &compression)) {
+        Nan::ThrowTypeError("third argument should be an object with valid "
+                            "options");
+        return;
+    }
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[3]->IsFunction()) {
+        Nan::ThrowTypeError("fourth argument should be a function");
+        return;
+    }
+    Nan::Callback *callback = new Nan::Callback(info[3].As<v8::Function>());
+
+    int fd = CheckSocket(socket, callback);
+    if (fd == -1)
+        return;
+
+    QueueReadWorker(fd, new ReadFrameWorker(callback, fd, prefix, max_bytes,
+                                              key, compression));
+    return;
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include <nan.h>
+
+#include "accounting.h"
+#include "common.h"
+#include "frames.h"
+#include "io.h"
+#include "rate-limit.h"
+#include "read-worker.h"
+
+class ReadFramesWorker : public ReadWorker {
+ private:
+    int fd;
+    bool fd_was_non_blocking;
+
+    PrefixSpec prefix;
+    size_t max_frames;
+    size_t max_bytes;
+
+    std::vector<FrameSpan> frames;
+    size_t size;
+    char *data;
+
+    /*
+     * Look at what is queued in the socket (without consuming it) until it
+     * holds at least one complete frame. Returns the number of bytes that
+     * complete frames span, or 0 in case of error.
+     */
+    size_t PeekFrames() {
+        for (;;) {
+            ssize_t n = Peek(fd, data, max_bytes, 0);
+            if (n == -1) {
+                SetSystemError("recv", errno);
+                return 0;
+            } else if (n == 0) {
+                SetEndOfFile(0);
+                return 0;
+            }
+
+            uint64_t needed;
+            size_t spanned = ScanFrames(prefix, data, n, max_frames, &frames,
+                                        &needed);
+            if (spanned > 0)
+                return spanned;
+
+            if (needed > max_bytes) {
+                SetError("frameTooLarge", "frame too large (%llu bytes)",
+                         needed);
+                return 0;
+            }
+
+            // Sleep until the missing bytes arrive.
+            n = Peek(fd, data, needed, MSG_WAITALL);
+            if (n == -1) {
+                SetSystemError("recv", errno);
+                return 0;
+            } else if ((size_t) n < needed) {
+                SetEndOfFile(0);
+                return 0;
+            }
+        }
+    }
+
+ public:
+    ReadFramesWorker(Nan::Callback *callback, int fd, PrefixSpec prefix,
+                     size_t max_frames, size_t max_bytes)
+            : ReadWorker(callback), fd(fd), prefix(prefix),
+              max_frames(max_frames), max_bytes(max_bytes) { }
+
+    ~ReadFramesWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        data = reinterpret_cast<char *>(malloc(max_bytes));
+        if (data == NULL) {
+            SetSystemError("malloc", errno);
+            return;
+        }
+
+        if (SetBlocking(fd, &fd_was_non_blocking)) {
+            SetSystemError("fcntl", errno);
+            free(data);
+            return;
+        }
+
+        uint64_t start = AccountingClock();
+        size = PeekFrames();
+        AccountBlocked(fd, start);
+        if (size == 0) {
+            free(data);
+        } else {
+            // These are the bytes we just peeked: read them for real.
+            ssize_t count = ReadExactly(fd, data, size);
+            if (count == -1) {
+                SetSystemError("read", errno);
+                free(data);
+            } else if ((size_t) count < size) {  // end of stream
+                SetEndOfFile(count);
+                free(data);
+            } else if (size < max_bytes) {
+                char *shrunk = reinterpret_cast<char *>(realloc(data, size));
+                if (shrunk != NULL)
+                    data = shrunk;
+            }
+        }
+
+        if (UnsetBlocking(fd, fd_was_non_blocking)) {
+            if (!HasError()) {
+                SetSystemError("fcntl", errno);
+                free(data);
+            }
+        }
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        v8::Local<v8::Object> buffer =
+                Nan::NewBuffer(data, (uint32_t) size).ToLocalChecked();
+
+        v8::Local<v8::Array> views = Nan::New<v8::Array>(frames.size());
+        for (size_t i = 0; i < frames.size(); i++)
+            views->Set(i, NewBufferView(buffer, frames[i].offset,
+                                        frames[i].length));
+
+        v8::Local<v8::Value> argv[] = { Nan::Null(), views };
+        callback->Call(2, argv);
+    }
+};
+
+NAN_METHOD(ReadFrames) {
+    if (info.Length() != 4) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' argument.
+     */
+    if (!LooksLikeASocket(info[0])) {
+        Nan::ThrowTypeError("first argument should be a socket");
+        return;
+    }
+    v8::Local<v8::Object> socket = info[0].As<v8::Object>();
+
+    /*
+     * Get 'prefix' argument.
+     */
+    PrefixSpec prefix;
+    if (!ParsePrefixSpec(info[1], &prefix)) {
+        Nan::ThrowTypeError("second argument should be a prefix type");
+        return;
+    }
+
+    /*
+     * Get 'options' argument.
+     */
+    size_t max_frames, max_bytes;
+    if (!info[2]->IsObject()
+            || !GetSizeOption(info[2].As<v8::Object>(), "maxFrames", 1024,
+                              &max_frames)
+            || !GetSizeOption(info[2].As<v8::Object>(), "maxBytes", 65536,
+                              &max_bytes)) {
+        Nan::ThrowTypeError("third argument should be an object with valid "
+                            "maxFrames and maxBytes");
+        return;
+    }
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[3]->IsFunction()) {
+        Nan::ThrowTypeError("fourth argument should be a function");
+        return;
+    }
+    Nan::Callback *callback = new Nan::Callback(info[3].As<v8::Function>());
+
+    int fd = CheckSocket(socket, callback);
+    if (fd == -1)
+        return;
+
+    QueueReadWorker(fd, new ReadFramesWorker(callback, fd, prefix,
+                                               max_frames, max_bytes));
+    return;
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <vector>
+
+#include <nan.h>
+
+#include "accounting.h"
+#include "capture.h"
+#include "common.h"
+#include "io.h"
+#include "rate-limit.h"
+#include "read-worker.h"
+
+/*
+ * Reads whole messages from a message-oriented socket (SOCK_SEQPACKET or
+ * SOCK_DGRAM), where each recv(2) returns exactly one message, truncated if
+ * the buffer is too small. The size of each message is learnt first with
+ * MSG_PEEK | MSG_TRUNC, so that exactly that much is allocated.
+ */
+class ReadMessagesWorker : public ReadWorker {
+ private:
+    int fd;
+    bool fd_was_non_blocking;
+
+    size_t max_messages;
+    size_t max_bytes;
+
+    std::vector<size_t> sizes;
+    size_t size;
+    char *data;
+
+    /*
+     * Size of the next message, waiting for it unless `flags` has
+     * MSG_DONTWAIT. Returns -1 in case of error.
+     */
+    ssize_t PeekMessageSize(int flags) {
+        for (;;) {
+            char byte;
+            ssize_t n = recv(fd, &byte, 1, MSG_PEEK | MSG_TRUNC | flags);
+            if (n == -1 && errno == EINTR)
+                continue;
+            return n;
+        }
+    }
+
+    /*
+     * Read the first message, waiting for it, then those already queued,
+     * within the limits.
+     */
+    void ReadMessages(bool seqpacket) {
+        size = 0;
+        data = NULL;
+
+        while (sizes.size() < max_messages) {
+            bool first = sizes.empty();
+            ssize_t length = PeekMessageSize(first ? 0 : MSG_DONTWAIT);
+            if (length == -1) {
+                if (!first && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    break;
+                SetSystemError("recv", errno);
+                break;
+            }
+            // On a SOCK_SEQPACKET socket, 0 is the end of stream.
+            if (length == 0 && seqpacket) {
+                if (first)
+                    SetEndOfFile(0);
+                break;
+            }
+
+            if ((size_t) length > max_bytes - size) {
+                if (first)
+                    SetError("frameTooLarge", "message too large (%llu "
+                             "bytes)", length);
+                break;
+            }
+
+            char *grown = reinterpret_cast<char *>(
+                    realloc(data, size + length ? size + length : 1));
+            if (grown == NULL) {
+                SetSystemError("malloc", errno);
+                break;
+            }
+            data = grown;
+
+            ssize_t n;
+            do {
+                n = recv(fd, &data[size], length, 0);
+            } while (n == -1 && errno == EINTR);
+            if (n == -1) {
+                SetSystemError("recv", errno);
+                break;
+            }
+
+            CaptureData(fd, &data[size], n);
+            AccountRead(fd, n);
+            sizes.push_back(n);
+            size += n;
+        }
+
+        if (HasError())
+            free(data);
+    }
+
+ public:
+    ReadMessagesWorker(Nan::Callback *callback, int fd, size_t max_messages,
+                       size_t max_bytes)
+            : ReadWorker(callback), fd(fd), max_messages(max_messages),
+              max_bytes(max_bytes) { }
+
+    ~ReadMessagesWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        int type;
+        socklen_t len = sizeof(type);
+        if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == -1) {
+            SetSystemError("getsockopt", errno);
+            return;
+        }
+        if (type != SOCK_SEQPACKET && type != SOCK_DGRAM) {
+            SetError("badStream", "not a message-oriented socket");
+            return;
+        }
+
+        if (SetBlocking(fd, &fd_was_non_blocking)) {
+            SetSystemError("fcntl", errno);
+            return;
+        }
+
+        uint64_t start = AccountingClock();
+        ReadMessages(type == SOCK_SEQPACKET);
+        AccountBlocked(fd, start);
+
+        if (UnsetBlocking(fd, fd_was_non_blocking)) {
+            if (!HasError()) {
+                SetSystemError("fcntl", errno);
+                free(data);
+            }
+        }
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        v8::Local<v8::Object> buffer = Nan::NewBuffer(
+                data, (uint32_t) size).ToLocalChecked();
+
+        v8::Local<v8::Array> messages = Nan::New<v8::Array>(sizes.size());
+        size_t offset = 0;
+        for (size_t i = 0; i < sizes.size(); i++) {
+            messages->Set(i, NewBufferView(buffer, offset, sizes[i]));
+            offset += sizes[i];
+        }
+
+        v8::Local<v8::Value> argv[] = { Nan::Null(), messages };
+        callback->Call(2, argv);
+    }
+};
+
+NAN_METHOD(ReadMessages) {
+    if (info.Length() != 3) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' or 'fd' argument.
+     */
+    bool is_socket = LooksLikeASocket(info[0]);
+    if (!is_socket && (!info[0]->IsNumber()
+                       || Nan::To<int>(info[0]).FromJust() < 0)) {
+        Nan::ThrowTypeError("first argument should be a socket or a file "
+                            "descriptor");
+        return;
+    }
+
+    /*
+     * Get 'options' argument.
+     */
+    size_t max_messages, max_bytes;
+    if (!info[1]->IsObject()
+            || !GetSizeOption(info[1].As<v8::Object>(), "maxMessages", 1,
+                              &max_messages)
+            || !GetSizeOption(info[1].As<v8::Object>(), "maxBytes",
+                              16 * 1024 * 1024, &max_bytes)) {
+        Nan::ThrowTypeError("second argument should be an object with valid "
+                            "options");
+        return;
+    }
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[2]->IsFunction()) {
+        Nan::ThrowTypeError("third argument should be a function");
+        return;
+    }
+    Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
+
+    int fd;
+    if (is_socket) {
+        fd = CheckSocket(info[0].As<v8::Object>(), callback);
+        if (fd == -1)
+            return;
+    } else {
+        fd = Nan::To<int>(info[0]).FromJust();
+    }
+
+    QueueReadWorker(fd, new ReadMessagesWorker(callback, fd, max_messages,
+                                               max_bytes));
+    return;
+}
+
+/*
+ * Create a connected pair of SOCK_SEQPACKET Unix sockets and return their file
+ * descriptors, for testing.
+ */
+NAN_METHOD(SeqpacketPair) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == -1) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "cannot create socket pair: %s",
+                 strerror(errno));
+        Nan::ThrowError(msg);
+        return;
+    }
+
+    v8::Local<v8::Array> result = Nan::New<v8::Array>(2);
+    result->Set(0, Nan::New<v8::Integer>(fds[0]));
+    result->Set(1, Nan::New<v8::Integer>(fds[1]));
+    info.GetReturnValue().Set(result);
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <nan.h>
+
+#include "accounting.h"
+#include "common.h"
+#include "read-worker.h"
+
+/*
+ * A contiguous part of the file, made of one or several requested ranges that
+ * are adjacent or overlap. `position` is where it starts in the result buffer.
+ */
+struct Span {
+    off_t offset;
+    size_t length;
+    size_t position;
+};
+
+/*
+ * Sort the requested ranges and merge those that are adjacent or overlap, so
+ * that each byte of the file is read at most once. Fills `positions` with
+ * where each requested range starts in the result buffer, and `size` with
+ * the size of that buffer.
+ */
+static std::vector<Span> Coalesce(const std::vector<FileRange> &ranges,
+                                  std::vector<size_t> *positions,
+                                  size_t *size) {
+    std::vector<size_t> order(ranges.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&ranges](size_t a, size_t b) {
+        return ranges[a].offset < ranges[b].offset;
+    });
+
+    std::vector<Span> spans;
+    positions->resize(ranges.size());
+    *size = 0;
+
+    for (size_t i : order) {
+        const FileRange &range = ranges[i];
+        off_t end = range.offset + range.length;
+
+        if (spans.empty() || range.offset >
+                spans.back().offset + (off_t) spans.back().length) {
+            Span span = { range.offset, range.length, *size };
+            spans.push_back(span);
+        } else if (end > spans.back().offset + (off_t) spans.back().length) {
+            spans.back().length = end - spans.back().offset;
+        }
+
+        Span &span = spans.back();
+        (*positions)[i] = span.position + (range.offset - span.offset);
+        *size = span.position + span.length;
+    }
+
+    return spans;
+}
+
+class ReadRangesWorker : public ReadWorker {
+ private:
+    int fd;
+
+    std::vector<FileRange> ranges;
+    std::vector<Span> spans;
+    std::vector<size_t> positions;
+
+    size_t size;
+    char *data;
+
+ public:
+    ReadRangesWorker(Nan::Callback *callback, int fd,
+                     const std::vector<FileRange> &ranges,
+                     const std::vector<Span> &spans,
+                     const std::vector<size_t> &positions, size_t size)
+            : ReadWorker(callback), fd(fd), ranges(ranges), spans(spans),
+              positions(positions), size(size) { }
+
+    ~ReadRangesWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        data = reinterpret_cast<char *>(malloc(size));
+        if (data == NULL) {
+            SetSystemError("malloc", errno);
+            return;
+        }
+
+        for (const Span &span : spans) {
+            size_t count = 0;
+
+            while (count < span.length) {
+                ssize_t n = pread(fd, &data[span.position + count],
+                                  span.length - count, span.offset + count);
+                if (n == -1) {
+                    if (errno == EINTR)
+                        continue;
+
+                    SetSystemError("pread", errno);
+                    free(data);
+                    return;
+                } else if (n == 0) {  // end of file
+                    SetEndOfFile("reached end of file (at offset %llu)",
+                                 span.offset + count);
+                    free(data);
+                    return;
+                } else {
+                    count += n;
+                }
+            }
+        }
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        v8::Local<v8::Object> buffer =
+                Nan::NewBuffer(data, (uint32_t) size).ToLocalChecked();
+
+        v8::Local<v8::Array> views = Nan::New<v8::Array>(ranges.size());
+        for (size_t i = 0; i < ranges.size(); i++)
+            views->Set(i, NewBufferView(buffer, positions[i],
+                                        ranges[i].length));
+
+        v8::Local<v8::Value> argv[] = { Nan::Null(), views };
+        callback->Call(2, argv);
+    }
+};
+
+NAN_METHOD(ReadRanges) {
+    if (info.Length() != 3) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'fd' argument.
+     */
+    if (!info[0]->IsNumber() || Nan::To<int>(info[0]).FromJust() < 0) {
+        Nan::ThrowTypeError("first argument should be a file descriptor");
+        return;
+    }
+    int fd = Nan::To<int>(info[0]).FromJust();
+
+    /*
+     * Get 'ranges' argument.
+     */
+    std::vector<FileRange> ranges;
+    if (!ParseRanges(info[1], &ranges)) {
+        Nan::ThrowTypeError("second argument should be an array of "
+                            "[offset, length] pairs");
+        return;
+    }
+
+    // Each range fits in a buffer, but all of them together may not.
+    std::vector<size_t> positions;
+    size_t size;
+    std::vector<Span> spans = Coalesce(ranges, &positions, &size);
+    if (size > node::Buffer::kMaxLength) {
+        Nan::ThrowRangeError("ranges would not fit in a buffer");
+        return;
+    }
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[2]->IsFunction()) {
+        Nan::ThrowTypeError("third argument should be a function");
+        return;
+    }
+    Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
+
+    // Files are not subject to rate limits: no need for QueueReadWorker().
+    AccountReadIssued(fd);
+    Nan::AsyncQueueWorker(new ReadRangesWorker(callback, fd, ranges, spans,
+                                               positions, size));
+    return;
+}
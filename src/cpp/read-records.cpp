@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+
+#include <nan.h>
+#include <node_buffer.h>
+
+#include "common.h"
+#include "io.h"
+#include "rate-limit.h"
+#include "read-worker.h"
+
+class ReadRecordsWorker : public ReadWorker {
+ private:
+    int fd;
+    bool fd_was_non_blocking;
+
+    size_t record_size;
+    size_t max_records;
+
+    size_t records;
+    char *data;
+
+ public:
+    ReadRecordsWorker(Nan::Callback *callback, int fd, size_t record_size,
+                      size_t max_records)
+            : ReadWorker(callback), fd(fd), record_size(record_size),
+              max_records(max_records) { }
+
+    ~ReadRecordsWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        bool is_file;
+
+        if (SetBlocking(fd, &fd_was_non_blocking)) {
+            SetSystemError("fcntl", errno);
+            return;
+        }
+
+        /*
+         * Take as many whole records as are already available. If there is
+         * not even one, wait for one on a stream, but don't consume the end
+         * of a file that doesn't hold a complete record.
+         */
+        ssize_t available = AvailableBytes(fd, &is_file);
+        if (available == -1) {
+            SetSystemError("ioctl", errno);
+            UnsetBlocking(fd, fd_was_non_blocking);
+            return;
+        }
+
+        records = available / record_size;
+        if (records > max_records)
+            records = max_records;
+
+        if (records == 0 && is_file) {
+            SetEndOfFile(0);
+            UnsetBlocking(fd, fd_was_non_blocking);
+            return;
+        } else if (records == 0) {
+            records = 1;
+        }
+
+        size_t size = records * record_size;
+
+        data = reinterpret_cast<char *>(malloc(size));
+        if (data == NULL) {
+            SetSystemError("malloc", errno);
+            UnsetBlocking(fd, fd_was_non_blocking);
+            return;
+        }
+
+        ssize_t count = ReadExactly(fd, data, size);
+        if (count == -1) {
+            SetSystemError("read", errno);
+            free(data);
+        } else if ((size_t) count < size) {  // end of stream
+            SetEndOfFile(count);
+            free(data);
+        }
+
+        if (UnsetBlocking(fd, fd_was_non_blocking)) {
+            if (!HasError()) {
+                SetSystemError("fcntl", errno);
+                free(data);
+            }
+        }
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        v8::Local<v8::Object> buffer = Nan::NewBuffer(
+                data, (uint32_t) (records * record_size)).ToLocalChecked();
+
+        v8::Local<v8::Array> views = Nan::New<v8::Array>(records);
+        for (size_t i = 0; i < records; i++)
+            views->Set(i, NewBufferView(buffer, i * record_size,
+                                        record_size));
+
+        v8::Local<v8::Value> argv[] = { Nan::Null(), views };
+        callback->Call(2, argv);
+    }
+};
+
+NAN_METHOD(ReadRecords) {
+    if (info.Length() != 4) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' or 'fd' argument.
+     */
+    bool is_socket = LooksLikeASocket(info[0]);
+    if (!is_socket && (!info[0]->IsNumber()
+                       || Nan::To<int>(info[0]).FromJust() < 0)) {
+        Nan::ThrowTypeError("first argument should be a socket or a file "
+                            "descriptor");
+        return;
+    }
+
+    /*
+     * Get 'recordSize' and 'count' arguments.
+     */
+    if (!info[1]->IsNumber() || Nan::To<int>(info[1]).FromJust() <= 0) {
+        Nan::ThrowTypeError("second argument should be a positive integer");
+        return;
+    }
+    size_t record_size = Nan::To<int>(info[1]).FromJust();
+
+    if (!info[2]->IsNumber() || Nan::To<int>(info[2]).FromJust() <= 0) {
+        Nan::ThrowTypeError("third argument should be a positive integer");
+        return;
+    }
+    size_t max_records = Nan::To<int>(info[2]).FromJust();
+
+    if (record_size * max_records > node::Buffer::kMaxLength) {
+        Nan::ThrowRangeError("records would not fit in a buffer");
+        return;
+    }
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[3]->IsFunction()) {
+        Nan::ThrowTypeError("fourth argument should be a function");
+        return;
+    }
+    Nan::Callback *callback = new Nan::Callback(info[3].As<v8::Function>());
+
+    int fd;
+    if (is_socket) {
+        fd = CheckSocket(info[0].As<v8::Object>(), callback);
+        if (fd == -1)
+            return;
+    } else {
+        fd = Nan::To<int>(info[0]).FromJust();
+    }
+
+    QueueReadWorker(fd, new ReadRecordsWorker(callback, fd, record_size,
+                                                max_records));
+    return;
+}
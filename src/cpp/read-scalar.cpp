@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <nan.h>
+
+#include "common.h"
+#include "io.h"
+#include "rate-limit.h"
+#include "read-worker.h"
+
+static v8::Local<v8::Value> ScalarToValue(uint8_t value) {
+    return Nan::New<v8::Uint32>(static_cast<uint32_t>(value));
+}
+
+static v8::Local<v8::Value> ScalarToValue(uint16_t value) {
+    return Nan::New<v8::Uint32>(static_cast<uint32_t>(value));
+}
+
+static v8::Local<v8::Value> ScalarToValue(uint32_t value) {
+    return Nan::New<v8::Uint32>(value);
+}
+
+#if V8_MAJOR_VERSION >= 7
+static v8::Local<v8::Value> ScalarToValue(uint64_t value) {
+    return v8::BigInt::NewFromUnsigned(v8::Isolate::GetCurrent(), value);
+}
+#endif
+
+/*
+ * Reads an unsigned integer of type `T` and passes it to the callback as a
+ * number, instead of a Buffer. The bytes are read on the stack: there is no
+ * allocation at all on success.
+ */
+template <typename T>
+class ScalarReadWorker : public ReadWorker {
+ private:
+    int fd;
+    bool fd_was_non_blocking;
+
+    bool big_endian;
+    T value;
+
+ public:
+    ScalarReadWorker(Nan::Callback *callback, int fd, bool big_endian)
+            : ReadWorker(callback), fd(fd), big_endian(big_endian) { }
+
+    ~ScalarReadWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        unsigned char bytes[sizeof(T)];
+
+        if (SetBlocking(fd, &fd_was_non_blocking)) {
+            SetSystemError("fcntl", errno);
+            return;
+        }
+
+        ssize_t count = ReadExactly(fd, reinterpret_cast<char *>(bytes),
+                                    sizeof(T));
+        if (count == -1) {
+            SetSystemError("read", errno);
+        } else if ((size_t) count < sizeof(T)) {  // end of stream
+            SetEndOfFile(count);
+        } else {
+            value = 0;
+            for (size_t i = 0; i < sizeof(T); i++)
+                value = (T) (value << 8) |
+                        bytes[big_endian ? i : sizeof(T) - 1 - i];
+        }
+
+        if (UnsetBlocking(fd, fd_was_non_blocking)) {
+            if (!HasError()) {
+                SetSystemError("fcntl", errno);
+            }
+        }
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        v8::Local<v8::Value> argv[] = { Nan::Null(), ScalarToValue(value) };
+        callback->Call(2, argv);
+    }
+};
+
+template <typename T>
+static void ReadScalar(NAN_METHOD_ARGS_TYPE info) {
+    if (info.Length() != 3) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' argument.
+     */
+    if (!LooksLikeASocket(info[0])) {
+        Nan::ThrowTypeError("first argument should be a socket");
+        return;
+    }
+    v8::Local<v8::Object> socket = info[0].As<v8::Object>();
+
+    /*
+     * Get 'endian' argument.
+     */
+    bool big_endian;
+    if (info[1]->IsString()
+            && !strcmp("BE", *Nan::Utf8String(info[1]))) {
+        big_endian = true;
+    } else if (info[1]->IsString()
+               && !strcmp("LE", *Nan::Utf8String(info[1]))) {
+        big_endian = false;
+    } else {
+        Nan::ThrowTypeError("second argument should be 'BE' or 'LE'");
+        return;
+    }
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[2]->IsFunction()) {
+        Nan::ThrowTypeError("third argument should be a function");
+        return;
+    }
+    Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
+
+    int fd = CheckSocket(socket, callback);
+    if (fd == -1)
+        return;
+
+    QueueReadWorker(fd, new ScalarReadWorker<T>(callback, fd, big_endian));
+}
+
+NAN_METHOD(ReadUInt8) {
+    ReadScalar<uint8_t>(info);
+}
+
+NAN_METHOD(ReadUInt16) {
+    ReadScalar<uint16_t>(info);
+}
+
+NAN_METHOD(ReadUInt32) {
+    ReadScalar<uint32_t>(info);
+}
+
+#if V8_MAJOR_VERSION >= 7
+NAN_METHOD(ReadBigUInt64) {
+    ReadScalar<uint64_t>(info);
+}
+#endif
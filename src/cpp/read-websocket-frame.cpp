@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <errno.h>
+
+#include <nan.h>
+
+#include "common.h"
+#include "io.h"
+#include "rate-limit.h"
+#include "read-worker.h"
+#include "slab.h"
+#include "websocket.h"
+
+/*
+ * Reads exactly one WebSocket frame and unmasks its payload in the worker
+ * thread.
+ */
+class ReadWebSocketFrameWorker : public ReadWorker {
+ private:
+    int fd;
+    bool fd_was_non_blocking;
+
+    size_t max_bytes;
+
+    WebSocketHeader header;
+    size_t size;
+    char *data;
+
+    /*
+     * Read the whole frame, header included. The header is only peeked
+     * first, so that a frame that is too large is not consumed at all.
+     */
+    void ReadFrame() {
+        char bytes[14];
+
+        size_t header_size = 2;
+        ssize_t count = PeekExactly(fd, bytes, header_size);
+        if (count == (ssize_t) header_size) {
+            header_size = WebSocketHeaderSize(bytes);
+            count = PeekExactly(fd, bytes, header_size);
+        }
+        if (count == -1) {
+            SetSystemError("recv", errno);
+            return;
+        } else if ((size_t) count < header_size) {
+            SetEndOfFile(0);
+            return;
+        }
+
+        if (!WebSocketParseHeader(bytes, &header)) {
+            SetError("badFrame", "invalid WebSocket frame header");
+            return;
+        }
+        if (header.payload_length > max_bytes) {
+            SetError("frameTooLarge", "frame too large (%llu bytes)",
+                     header.size + header.payload_length);
+            return;
+        }
+
+        size = header.size + header.payload_length;
+        data = reinterpret_cast<char *>(malloc(size));
+        if (data == NULL) {
+            SetSystemError("malloc", errno);
+            return;
+        }
+
+        count = ReadExactly(fd, data, size);
+        if (count == -1) {
+            SetSystemError("read", errno);
+            free(data);
+        } else if ((size_t) count < size) {  // end of stream
+            SetEndOfFile(count);
+            free(data);
+        }
+    }
+
+ public:
+    ReadWebSocketFrameWorker(Nan::Callback *callback, int fd,
+                             size_t max_bytes)
+            : ReadWorker(callback), fd(fd), max_bytes(max_bytes) { }
+
+    ~ReadWebSocketFrameWorker() {}
+
+    /*
+     * Executed inside the worker-thread. It is not safe to access V8, or V8
+     * data structures here, so everything we need for input and output should
+     * go on `this`.
+     */
+    void Execute() {
+        if (SetBlocking(fd, &fd_was_non_blocking)) {
+            SetSystemError("fcntl", errno);
+            return;
+        }
+
+        ReadFrame();
+
+        if (UnsetBlocking(fd, fd_was_non_blocking)) {
+            if (!HasError()) {
+                SetSystemError("fcntl", errno);
+                free(data);
+            }
+        }
+
+        if (!HasError() && header.masked
+                && !DeferTransform(header.payload_length))
+            Transform();
+    }
+
+    void Transform() {
+        WebSocketUnmask(&data[header.size], header.payload_length,
+                        header.mask);
+    }
+
+    /*
+     * Executed when the async work is complete this function will be run
+     * inside the main event loop so it is safe to use V8 again.
+     */
+    void HandleOKCallback() {
+        Nan::HandleScope scope;
+
+        v8::Local<v8::Object> payload;
+        if (IsSmallResult(header.payload_length)) {
+            payload = NewSmallBuffer(&data[header.size],
+                                     header.payload_length);
+            free(data);
+        } else {
+            v8::Local<v8::Object> buffer =
+                    Nan::NewBuffer(data, (uint32_t) size).ToLocalChecked();
+            payload = NewBufferView(buffer, header.size,
+                                    header.payload_length);
+        }
+
+        v8::Local<v8::Object> frame = Nan::New<v8::Object>();
+        frame->Set(Nan::New<v8::String>("fin").ToLocalChecked(),
+                   Nan::New<v8::Boolean>(header.fin));
+        frame->Set(Nan::New<v8::String>("rsv").ToLocalChecked(),
+                   Nan::New<v8::Integer>(header.rsv));
+        frame->Set(Nan::New<v8::String>("opcode").ToLocalChecked(),
+                   Nan::New<v8::Integer>(header.opcode));
+        frame->Set(Nan::New<v8::String>("masked").ToLocalChecked(),
+                   Nan::New<v8::Boolean>(header.masked));
+        frame->Set(Nan::New<v8::String>("payload").ToLocalChecked(),
+                   payload);
+
+        v8::Local<v8::Value> argv[] = { Nan::Null(), frame };
+        callback->Call(2, argv);
+    }
+};
+
+NAN_METHOD(ReadWebSocketFrame) {
+    if (info.Length() != 3) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'socket' argument.
+     */
+    if (!LooksLikeASocket(info[0])) {
+        Nan::ThrowTypeError("first argument should be a socket");
+        return;
+    }
+    v8::Local<v8::Object> socket = info[0].As<v8::Object>();
+
+    /*
+     * Get 'options' argument.
+     */
+    size_t max_bytes;
+    if (!info[1]->IsObject()
+            || !GetSizeOption(info[1].As<v8::Object>(), "maxBytes",
+                              16 * 1024 * 1024, &max_bytes)) {
+        Nan::ThrowTypeError("second argument should be an object with valid "
+                            "options");
+        return;
+    }
+
+    /*
+     * Get 'callback' argument.
+     */
+    if (!info[2]->IsFunction()) {
+        Nan::ThrowTypeError("third argument should be a function");
+        return;
+    }
+    Nan::Callback *callback = new Nan::Callback(info[2].As<v8::Function>());
+
+    int fd = CheckSocket(socket, callback);
+    if (fd == -1)
+        return;
+
+    QueueReadWorker(fd, new ReadWebSocketFrameWorker(callback, fd,
+                                                       max_bytes));
+    return;
+}
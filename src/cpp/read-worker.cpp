@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include <nan.h>
+#include <uv.h>
+
+#include "common.h"
+#include "rate-limit.h"
+#include "read-worker.h"
+#include "transform-pool.h"
+
+/*
+ * In "fast errors" mode, errors are reported as small plain objects, shared
+ * between all errors of the same kind, instead of `Error` instances: there is
+ * no stack trace to capture nor message to format.
+ */
+static bool fast_errors = false;
+
+typedef std::pair<std::string, int> DescriptorKey;
+static std::map<DescriptorKey, Nan::Persistent<v8::Object> *> descriptors;
+
+static void SetCodeAndErrno(v8::Local<v8::Object> error, const char *code,
+                            int errnum) {
+    if (code != NULL)
+        error->Set(Nan::New<v8::String>("code").ToLocalChecked(),
+                   Nan::New<v8::String>(code).ToLocalChecked());
+    if (errnum != 0)
+        error->Set(Nan::New<v8::String>("errno").ToLocalChecked(),
+                   Nan::New<v8::Int32>(errnum));
+}
+
+/*
+ * Equivalent of `{ [property]: true, code, errno }`, created once per kind of
+ * error and reused.
+ */
+static v8::Local<v8::Object> ErrorDescriptor(const char *property,
+                                             const char *code, int errnum) {
+    DescriptorKey key(property, errnum);
+
+    std::map<DescriptorKey, Nan::Persistent<v8::Object> *>::iterator it =
+            descriptors.find(key);
+    if (it != descriptors.end())
+        return Nan::New(*it->second);
+
+    v8::Local<v8::Object> descriptor = Nan::New<v8::Object>();
+    descriptor->Set(Nan::New<v8::String>(property).ToLocalChecked(),
+                    Nan::True());
+    SetCodeAndErrno(descriptor, code, errnum);
+
+    Nan::Persistent<v8::Object> *persistent =
+            new Nan::Persistent<v8::Object>(descriptor);
+    descriptors[key] = persistent;
+
+    return descriptor;
+}
+
+void ReadWorker::SetSystemError(const char *syscall, int errnum) {
+    error_prop = "systemError";
+    error_code = uv_err_name(-errnum);
+    error_syscall = syscall;
+    error_errno = errnum;
+    // Nan only needs a message to know that the work failed: don't format it
+    // yet.
+    SetErrorMessage(syscall);
+}
+
+void ReadWorker::SetEndOfFile(size_t count) {
+    SetEndOfFile("reached end of stream (read %llu bytes)", count);
+}
+
+void ReadWorker::SetEndOfFile(const char *format, unsigned long long value) {
+    SetError("endOfFile", format, value);
+    error_code = "EOF";
+}
+
+/*
+ * `format` must be a string literal, with at most one `%llu` for `value`.
+ */
+void ReadWorker::SetError(const char *property, const char *format,
+                          unsigned long long value) {
+    error_prop = property;
+    error_format = format;
+    error_value = value;
+    SetErrorMessage(property);
+}
+
+v8::Local<v8::Value> ReadWorker::NewError() {
+    if (fast_errors)
+        return ErrorDescriptor(error_prop, error_code, error_errno);
+
+    char msg[256];
+    if (error_syscall != NULL)
+        snprintf(msg, sizeof(msg), "%s failed: %s", error_syscall,
+                 strerror(error_errno));
+    else
+        snprintf(msg, sizeof(msg), error_format, error_value);
+
+    v8::Local<v8::Value> error = ErrorWithProperty(error_prop, msg);
+    SetCodeAndErrno(error.As<v8::Object>(), error_code, error_errno);
+
+    return error;
+}
+
+void ReadWorker::HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    v8::Local<v8::Value> argv[] = { NewError() };
+    callback->Call(1, argv);
+}
+
+/*
+ * Report an error without ever running, for a read dropped before it reached
+ * a thread. `message` must be a string literal.
+ */
+void ReadWorker::Abort(const char *property, const char *message) {
+    SetError(property, message);
+    WorkComplete();
+    Destroy();
+}
+
+/*
+ * Called from Execute(): leave the transform of `size` bytes to the transform
+ * pool, if it takes it, so that this thread is free for the next read.
+ */
+bool ReadWorker::DeferTransform(size_t size) {
+    if (!TransformPoolAccepts(size))
+        return false;
+
+    transform_pending = true;
+    return true;
+}
+
+/*
+ * Let the admission control know that a read it let through is done, before
+ * calling back. Once the I/O is done, the next read of the same fds can start,
+ * even with a transform pending. The read itself still holds its buffer, so
+ * it keeps counting against the reads in flight until the transform pool
+ * completes it. It only calls back after the reads admitted before it.
+ */
+void ReadWorker::WorkComplete() {
+    if (admitted && !io_done) {
+        io_done = true;
+        ReadIoDone(this);
+    }
+
+    if (transform_pending)
+        return;
+
+    if (admitted) {
+        ReadCompleted();
+        admitted = false;
+    }
+
+    if (!ReadTurn(this)) {
+        held = true;
+        return;
+    }
+
+    Nan::AsyncWorker::WorkComplete();
+    ReadCalledBack(this);
+}
+
+/*
+ * The transform is only queued here, once the threadpool is done with this
+ * worker: it may then be completed, and deleted, at any time. A held worker
+ * is deleted by CallBack().
+ */
+void ReadWorker::Destroy() {
+    if (transform_pending) {
+        TransformPoolQueue(this);
+        return;
+    }
+    if (held)
+        return;
+
+    Nan::AsyncWorker::Destroy();
+}
+
+/*
+ * Call back for a held worker, once its turn has come.
+ */
+void ReadWorker::CallBack() {
+    held = false;
+    Nan::AsyncWorker::WorkComplete();
+    ReadCalledBack(this);
+    Nan::AsyncWorker::Destroy();
+}
+
+NAN_METHOD(SetFastErrors) {
+    if (info.Length() != 1 || !info[0]->IsBoolean()) {
+        Nan::ThrowTypeError("first argument should be a boolean");
+        return;
+    }
+
+    fast_errors = Nan::To<bool>(info[0]).FromJust();
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef READ_WORKER_H
+# define READ_WORKER_H
+
+#include <vector>
+
+#include <nan.h>
+
+/*
+ * Base class of the workers. It keeps the error state of each request (not
+ * shared between threads) as plain values, and only builds the message and
+ * the JavaScript error object if and when the error is reported.
+ */
+class ReadWorker : public Nan::AsyncWorker {
+ private:
+    const char *error_prop = NULL;
+    const char *error_code = NULL;
+    const char *error_syscall = NULL;
+    int error_errno = 0;
+    const char *error_format = NULL;
+    unsigned long long error_value = 0;
+
+    bool admitted = false;
+    bool io_done = false;
+    bool transform_pending = false;
+    bool held = false;  // done, but waiting for an earlier read to call back
+    std::vector<int> admitted_fds;
+
+ protected:
+    void SetSystemError(const char *syscall, int errnum);
+    void SetEndOfFile(size_t count);
+    void SetEndOfFile(const char *format, unsigned long long value);
+    void SetError(const char *property, const char *format,
+                  unsigned long long value = 0);
+
+    bool HasError() const { return error_prop != NULL; }
+
+    bool DeferTransform(size_t size);
+
+    v8::Local<v8::Value> NewError();
+
+    void HandleErrorCallback();
+
+ public:
+    explicit ReadWorker(Nan::Callback *callback)
+            : Nan::AsyncWorker(callback) { }
+
+    void MarkAdmitted(const std::vector<int> &fds) {
+        admitted = true;
+        admitted_fds = fds;
+    }
+    const std::vector<int> &AdmittedFds() const { return admitted_fds; }
+    bool TransformPending() const { return transform_pending; }
+    bool Held() const { return held; }
+
+    void Abort(const char *property, const char *message);
+    void WorkComplete();
+    void Destroy();
+    void CallBack();
+
+    /*
+     * CPU-bound post-processing of what Execute() read (decryption,
+     * unmasking...), run by the worker thread itself, or by the transform
+     * pool if Execute() deferred it.
+     */
+    virtual void Transform() { }
+    void RunDeferredTransform() {
+        Transform();
+        transform_pending = false;
+    }
+};
+
+NAN_METHOD(SetFastErrors);
+
+#endif /* READ_WORKER_H */
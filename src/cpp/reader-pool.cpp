@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * A pool of reader threads, used instead of the libuv threadpool when
+ * enabled. Its threads spend most of their time blocked in read(), so its
+ * size can't be fixed well: it grows, up to `maxThreads`, whenever a read is
+ * queued while all threads are busy, and a thread exits after `idleMs`
+ * without work, down to `minThreads`.
+ *
+ * Completed reads are handed back to the event loop with a uv_async_t, which
+ * only keeps the loop alive while reads are in flight.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <deque>
+#include <vector>
+
+#include <nan.h>
+#include <uv.h>
+
+#include "common.h"
+#include "reader-pool.h"
+
+struct QueuedRead {
+    ReadWorker *worker;
+    uint64_t queued;  // uv_hrtime()
+};
+
+struct ScaleEvent {
+    bool grown;
+    size_t threads;
+};
+
+/*
+ * Queue waits in microseconds, in buckets of 4 per power of two: precise
+ * enough for percentiles, in a fixed size.
+ */
+#define WAIT_BUCKETS 252
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_available;
+
+// Protected by `lock`.
+static bool enabled;
+static size_t min_threads, max_threads;
+static uint64_t idle_ms;
+static size_t threads, idle_threads;
+static std::deque<QueuedRead> queue;
+static std::vector<ReadWorker *> completed;
+static std::vector<ScaleEvent> scale_events;
+static uint64_t grown, shrunk;
+static uint64_t wait_histogram[WAIT_BUCKETS];
+static uint64_t wait_count;
+
+// Main thread only.
+static uv_async_t async;
+static bool initialized;
+static size_t outstanding;
+static Nan::Callback *on_scale;
+
+static size_t WaitBucket(uint64_t us) {
+    if (us < 4)
+        return us;
+    int msb = 63 - __builtin_clzll(us);
+    return 4 * (msb - 1) + ((us >> (msb - 2)) & 3);
+}
+
+/*
+ * Upper bound of a bucket, in microseconds.
+ */
+static uint64_t WaitBucketLimit(size_t bucket) {
+    if (bucket < 4)
+        return bucket;
+    int msb = bucket / 4 + 1;
+    return ((uint64_t) (4 + bucket % 4 + 1) << (msb - 2)) - 1;
+}
+
+static void *ReaderThread(void *);
+
+/*
+ * Start one more thread. Called with `lock` held.
+ */
+static bool SpawnThread() {
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&thread, &attr, ReaderThread, NULL);
+    pthread_attr_destroy(&attr);
+    if (err) {
+        errno = err;
+        return false;
+    }
+
+    threads++;
+    return true;
+}
+
+static void ScaleEventLocked(bool grow) {
+    if (grow)
+        grown++;
+    else
+        shrunk++;
+    // Only kept for the `onScale` callback, and bounded if it is slow.
+    if (scale_events.size() < 1024) {
+        ScaleEvent event = { grow, threads };
+        scale_events.push_back(event);
+    }
+}
+
+static void *ReaderThread(void *) {
+    pthread_mutex_lock(&lock);
+
+    for (;;) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += idle_ms / 1000;
+        deadline.tv_nsec += (idle_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        // Leave when above the bounds (after they were lowered, or the pool
+        // disabled), or idle for too long. The count is updated right away,
+        // so that other threads don't leave too. Threads that the minimum
+        // keeps wait without a timeout: once the deadline has passed, a timed
+        // wait would return at once.
+        bool leave = false;
+        while (queue.empty() && !leave) {
+            if (threads > max_threads) {
+                leave = true;
+                break;
+            }
+            idle_threads++;
+            int err = 0;
+            if (threads > min_threads)
+                err = pthread_cond_timedwait(&work_available, &lock,
+                                             &deadline);
+            else
+                pthread_cond_wait(&work_available, &lock);
+            idle_threads--;
+            if (err == ETIMEDOUT && queue.empty() && threads > min_threads)
+                leave = true;
+        }
+        if (leave) {
+            threads--;
+            break;
+        }
+
+        QueuedRead read = queue.front();
+        queue.pop_front();
+        wait_histogram[WaitBucket((uv_hrtime() - read.queued) / 1000)]++;
+        wait_count++;
+        pthread_mutex_unlock(&lock);
+
+        read.worker->Execute();
+
+        pthread_mutex_lock(&lock);
+        completed.push_back(read.worker);
+        uv_async_send(&async);
+    }
+
+    ScaleEventLocked(false);
+    pthread_mutex_unlock(&lock);
+    uv_async_send(&async);
+
+    return NULL;
+}
+
+/*
+ * Executed in the event loop: call back for the completed reads, and report
+ * scaling events.
+ */
+static void OnAsync(uv_async_t *) {
+    Nan::HandleScope scope;
+    std::vector<ReadWorker *> workers;
+    std::vector<ScaleEvent> events;
+
+    pthread_mutex_lock(&lock);
+    workers.swap(completed);
+    events.swap(scale_events);
+    pthread_mutex_unlock(&lock);
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->WorkComplete();
+        workers[i]->Destroy();
+    }
+    outstanding -= workers.size();
+    if (outstanding == 0)
+        uv_unref(reinterpret_cast<uv_handle_t *>(&async));
+
+    for (size_t i = 0; on_scale != NULL && i < events.size(); i++) {
+        v8::Local<v8::Value> argv[] = {
+                Nan::New<v8::String>(events[i].grown ? "grow" : "shrink")
+                        .ToLocalChecked(),
+                Nan::New<v8::Number>(events[i].threads) };
+        on_scale->Call(2, argv);
+    }
+}
+
+bool ReaderPoolEnabled() {
+    return enabled;
+}
+
+/*
+ * Queue a read to the pool, starting a thread if none is idle to take it.
+ */
+void ReaderPoolQueue(ReadWorker *worker) {
+    if (outstanding++ == 0)
+        uv_ref(reinterpret_cast<uv_handle_t *>(&async));
+
+    QueuedRead read = { worker, uv_hrtime() };
+
+    pthread_mutex_lock(&lock);
+    queue.push_back(read);
+    if (queue.size() > idle_threads && threads < max_threads
+            && SpawnThread())
+        ScaleEventLocked(true);
+    // No thread could be started at all: fall back to the libuv threadpool.
+    bool stranded = threads == 0;
+    if (stranded)
+        queue.pop_back();
+    else
+        pthread_cond_signal(&work_available);
+    pthread_mutex_unlock(&lock);
+
+    if (stranded) {
+        if (--outstanding == 0)
+            uv_unref(reinterpret_cast<uv_handle_t *>(&async));
+        Nan::AsyncQueueWorker(worker);
+    }
+}
+
+/*
+ * Get an optional non-negative integer option.
+ */
+static bool GetCountOption(v8::Local<v8::Object> options, const char *name,
+                           uint64_t default_value, uint64_t *value) {
+    v8::Local<v8::String> key = Nan::New<v8::String>(name).ToLocalChecked();
+
+    *value = default_value;
+    if (!options->Has(key))
+        return true;
+
+    v8::Local<v8::Value> option = options->Get(key);
+    if (!option->IsNumber())
+        return false;
+
+    double number = Nan::To<double>(option).FromJust();
+    if (number < 0 || number != static_cast<int64_t>(number))
+        return false;
+
+    *value = static_cast<uint64_t>(number);
+    return true;
+}
+
+static void Initialize() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&work_available, &attr);
+    pthread_condattr_destroy(&attr);
+
+    uv_async_init(uv_default_loop(), &async, OnAsync);
+    uv_unref(reinterpret_cast<uv_handle_t *>(&async));
+    initialized = true;
+}
+
+NAN_METHOD(SetReaderPool) {
+    if (info.Length() != 1) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'options' argument, or null to go back to the libuv threadpool.
+     * Reads already queued to the pool still complete there.
+     */
+    uint64_t new_min = 0, new_max = 0, new_idle_ms = 0;
+    v8::Local<v8::Value> callback;
+    bool disable = info[0]->IsNull();
+    if (!disable) {
+        if (!info[0]->IsObject()) {
+            Nan::ThrowTypeError("first argument should be an object, or "
+                                "null");
+            return;
+        }
+        v8::Local<v8::Object> options = info[0].As<v8::Object>();
+        callback = options->Get(Nan::New<v8::String>("onScale")
+                .ToLocalChecked());
+        if (!GetCountOption(options, "minThreads", 1, &new_min)
+                || !GetCountOption(options, "maxThreads", 64, &new_max)
+                || !GetCountOption(options, "idleMs", 10000, &new_idle_ms)
+                || new_max == 0 || new_min > new_max
+                || (!callback->IsUndefined() && !callback->IsFunction())) {
+            Nan::ThrowTypeError("first argument should be an object with "
+                                "valid options");
+            return;
+        }
+    }
+
+    if (!initialized)
+        Initialize();
+
+    delete on_scale;
+    on_scale = NULL;
+    if (!disable && callback->IsFunction())
+        on_scale = new Nan::Callback(callback.As<v8::Function>());
+
+    pthread_mutex_lock(&lock);
+    enabled = !disable;
+    min_threads = new_min;
+    max_threads = new_max;
+    idle_ms = new_idle_ms;
+    while (threads < min_threads && SpawnThread())
+        ScaleEventLocked(true);
+    // Let threads above the new bounds exit.
+    pthread_cond_broadcast(&work_available);
+    pthread_mutex_unlock(&lock);
+
+    if (enabled && threads < min_threads) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "cannot start reader threads: %s",
+                 strerror(errno));
+        Nan::ThrowError(msg);
+        return;
+    }
+}
+
+NAN_METHOD(ReaderPoolStats) {
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    const char *names[] = { "p50", "p90", "p99", "p999" };
+    double waits[4] = { 0, 0, 0, 0 };
+
+    pthread_mutex_lock(&lock);
+    size_t n_threads = threads, n_idle = idle_threads;
+    size_t n_queued = queue.size();
+    uint64_t n_grown = grown, n_shrunk = shrunk, n_waits = wait_count;
+    if (wait_count) {
+        size_t p = 0;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < WAIT_BUCKETS && p < 4; i++) {
+            seen += wait_histogram[i];
+            while (p < 4 && seen >= percentiles[p] * wait_count)
+                waits[p++] = WaitBucketLimit(i) / 1e3;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+
+    result->Set(Nan::New<v8::String>("threads").ToLocalChecked(),
+                Nan::New<v8::Number>(n_threads));
+    result->Set(Nan::New<v8::String>("busyThreads").ToLocalChecked(),
+                Nan::New<v8::Number>(n_threads - n_idle));
+    result->Set(Nan::New<v8::String>("queuedReads").ToLocalChecked(),
+                Nan::New<v8::Number>(n_queued));
+    result->Set(Nan::New<v8::String>("grown").ToLocalChecked(),
+                Nan::New<v8::Number>(n_grown));
+    result->Set(Nan::New<v8::String>("shrunk").ToLocalChecked(),
+                Nan::New<v8::Number>(n_shrunk));
+
+    v8::Local<v8::Object> wait = Nan::New<v8::Object>();
+    wait->Set(Nan::New<v8::String>("count").ToLocalChecked(),
+              Nan::New<v8::Number>(n_waits));
+    for (size_t i = 0; i < 4; i++)
+        wait->Set(Nan::New<v8::String>(names[i]).ToLocalChecked(),
+                  Nan::New<v8::Number>(waits[i]));
+    result->Set(Nan::New<v8::String>("queueWaitMs").ToLocalChecked(), wait);
+
+    info.GetReturnValue().Set(result);
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Small results are copied into a shared slab and returned as views of it,
+ * like Node.js does for `Buffer.allocUnsafe()`: creating (and later
+ * collecting) one backing store with its own finalizer costs more than the
+ * read itself for a few bytes. A slab is used until it is full; it is freed
+ * once all its views are collected.
+ */
+
+#include <string.h>
+
+#include <nan.h>
+#include <node_buffer.h>
+
+#include "common.h"
+#include "memory-pressure.h"
+#include "slab.h"
+
+static size_t slab_size = 8192;
+static size_t max_small_size = 64;
+
+static Nan::Persistent<v8::Object> slab;
+static size_t slab_used;
+static bool trimmer_added;
+
+bool IsSmallResult(size_t size) {
+    return max_small_size != 0 && size <= max_small_size;
+}
+
+/*
+ * Drop the current slab, so that it can be freed as soon as its views are.
+ * Returns its unused bytes.
+ */
+static size_t TrimSlab() {
+    if (slab.IsEmpty())
+        return 0;
+
+    size_t unused = slab_size - slab_used;
+    slab.Reset();
+    return unused;
+}
+
+/*
+ * Copy `size` bytes (no more than the maximum size of a small result) into
+ * the slab and return a buffer viewing them.
+ */
+v8::Local<v8::Object> NewSmallBuffer(const char *data, size_t size) {
+    if (!trimmer_added) {
+        AddMemoryTrimmer(TrimSlab);
+        trimmer_added = true;
+    }
+
+    if (slab.IsEmpty() || slab_used + size > slab_size) {
+        slab.Reset(Nan::NewBuffer((uint32_t) slab_size).ToLocalChecked());
+        slab_used = 0;
+    }
+
+    v8::Local<v8::Object> buffer = Nan::New(slab);
+    memcpy(node::Buffer::Data(buffer) + slab_used, data, size);
+    v8::Local<v8::Object> view = NewBufferView(buffer, slab_used, size);
+
+    // Keep views 8-byte aligned, as Node.js does for its pool.
+    slab_used += (size + 7) & ~(size_t) 7;
+
+    return view;
+}
+
+NAN_METHOD(SetSmallResultPool) {
+    if (info.Length() != 1 || !info[0]->IsObject()) {
+        Nan::ThrowTypeError("first argument should be an object");
+        return;
+    }
+    v8::Local<v8::Object> options = info[0].As<v8::Object>();
+
+    /*
+     * maxSize: 0 disables the pool.
+     */
+    size_t new_slab_size, new_max_size;
+    v8::Local<v8::String> key = Nan::New<v8::String>("maxSize")
+            .ToLocalChecked();
+    bool disable = options->Has(key) && options->Get(key)->IsNumber()
+            && Nan::To<double>(options->Get(key)).FromJust() == 0;
+    if (!GetSizeOption(options, "slabSize", slab_size, &new_slab_size)
+            || (!disable && !GetSizeOption(options, "maxSize", max_small_size,
+                                           &new_max_size))
+            || (!disable && new_max_size > new_slab_size)) {
+        Nan::ThrowTypeError("first argument should be an object with valid "
+                            "options");
+        return;
+    }
+
+    TrimSlab();
+    slab_size = new_slab_size;
+    max_small_size = disable ? 0 : new_max_size;
+}
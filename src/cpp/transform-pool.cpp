@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Second stage of reads with CPU-bound post-processing: the thread that read
+ * the data leaves the transform to this pool, sized to the number of cores,
+ * and goes on with the next read. Without it, threads blocked in read() and
+ * threads computing compete for the same pool, and a large payload holds a
+ * reader thread long after its bytes are in.
+ *
+ * Each thread has its own queue; transforms are spread over them and an idle
+ * thread steals from the others, so a long transform doesn't hold back those
+ * queued behind it.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <deque>
+#include <vector>
+
+#include <nan.h>
+#include <uv.h>
+
+#include "common.h"
+#include "rate-limit.h"
+#include "transform-pool.h"
+
+struct TransformThread {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    std::deque<ReadWorker *> queue;
+};
+
+static std::vector<TransformThread *> pool;
+static size_t min_transform_size;
+
+// Protected by `lock`.
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_available = PTHREAD_COND_INITIALIZER;
+static size_t pending;
+static bool stopping;
+static std::vector<ReadWorker *> completed;
+static uint64_t transforms, steals;
+
+// Main thread only.
+static uv_async_t async;
+static bool async_initialized;
+static size_t outstanding;
+static size_t next_thread;
+
+/*
+ * Take a transform from the front of our queue, or else from the back of
+ * another thread's one.
+ */
+static ReadWorker *TakeTransform(size_t self, bool *stolen) {
+    ReadWorker *worker = NULL;
+
+    for (size_t i = 0; i < pool.size() && worker == NULL; i++) {
+        TransformThread *thread = pool[(self + i) % pool.size()];
+        pthread_mutex_lock(&thread->lock);
+        if (!thread->queue.empty()) {
+            if (i == 0) {
+                worker = thread->queue.front();
+                thread->queue.pop_front();
+            } else {
+                worker = thread->queue.back();
+                thread->queue.pop_back();
+            }
+        }
+        pthread_mutex_unlock(&thread->lock);
+        *stolen = i != 0;
+    }
+
+    return worker;
+}
+
+static void *TransformLoop(void *arg) {
+    size_t self = reinterpret_cast<size_t>(arg);
+
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        while (pending == 0 && !stopping)
+            pthread_cond_wait(&work_available, &lock);
+        if (pending == 0) {  // stopping, and all transforms are done
+            pthread_mutex_unlock(&lock);
+            return NULL;
+        }
+        pending--;
+        pthread_mutex_unlock(&lock);
+
+        // `pending` guarantees that there is one for us in some queue.
+        bool stolen;
+        ReadWorker *worker;
+        while ((worker = TakeTransform(self, &stolen)) == NULL) { }
+
+        worker->RunDeferredTransform();
+
+        pthread_mutex_lock(&lock);
+        completed.push_back(worker);
+        transforms++;
+        if (stolen)
+            steals++;
+        pthread_mutex_unlock(&lock);
+        uv_async_send(&async);
+    }
+}
+
+/*
+ * Executed in the event loop: call back for the transformed reads.
+ */
+static void OnAsync(uv_async_t *) {
+    Nan::HandleScope scope;
+    std::vector<ReadWorker *> workers;
+
+    pthread_mutex_lock(&lock);
+    workers.swap(completed);
+    pthread_mutex_unlock(&lock);
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->WorkComplete();
+        workers[i]->Destroy();
+    }
+    outstanding -= workers.size();
+    if (outstanding == 0)
+        uv_unref(reinterpret_cast<uv_handle_t *>(&async));
+}
+
+/*
+ * Whether a transform of `size` bytes is worth a trip to the pool. Called
+ * from worker threads, while the pool can only be changed from the main
+ * thread with no read in flight using it (see SetTransformPool()).
+ */
+bool TransformPoolAccepts(size_t size) {
+    return !pool.empty() && size >= min_transform_size;
+}
+
+void TransformPoolQueue(ReadWorker *worker) {
+    if (outstanding++ == 0)
+        uv_ref(reinterpret_cast<uv_handle_t *>(&async));
+
+    TransformThread *thread = pool[next_thread++ % pool.size()];
+    pthread_mutex_lock(&thread->lock);
+    thread->queue.push_back(worker);
+    pthread_mutex_unlock(&thread->lock);
+
+    pthread_mutex_lock(&lock);
+    pending++;
+    pthread_cond_signal(&work_available);
+    pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Wait for queued transforms, then for the threads to exit.
+ */
+static void StopPool() {
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_broadcast(&work_available);
+    pthread_mutex_unlock(&lock);
+
+    for (size_t i = 0; i < pool.size(); i++) {
+        pthread_join(pool[i]->thread, NULL);
+        pthread_mutex_destroy(&pool[i]->lock);
+        delete pool[i];
+    }
+    pool.clear();
+
+    stopping = false;
+}
+
+static bool StartPool(size_t threads) {
+    for (size_t i = 0; i < threads; i++) {
+        TransformThread *thread = new TransformThread();
+        pthread_mutex_init(&thread->lock, NULL);
+        int err = pthread_create(&thread->thread, NULL, TransformLoop,
+                                 reinterpret_cast<void *>(i));
+        if (err) {
+            pthread_mutex_destroy(&thread->lock);
+            delete thread;
+            StopPool();
+            errno = err;
+            return false;
+        }
+        pool.push_back(thread);
+    }
+
+    return true;
+}
+
+NAN_METHOD(SetTransformPool) {
+    if (info.Length() != 1) {
+        Nan::ThrowTypeError("wrong number of arguments");
+        return;
+    }
+
+    /*
+     * Get 'options' argument, or null to transform in the reading threads
+     * again.
+     */
+    size_t threads = 0, min_size = 0;
+    bool disable = info[0]->IsNull();
+    if (!disable) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        if (!info[0]->IsObject()
+                || !GetSizeOption(info[0].As<v8::Object>(), "threads",
+                                  cores > 0 ? cores : 1, &threads)
+                || !GetSizeOption(info[0].As<v8::Object>(), "minBytes",
+                                  16 * 1024, &min_size)
+                || threads > 1024) {
+            Nan::ThrowTypeError("first argument should be an object with "
+                                "valid options, or null");
+            return;
+        }
+    }
+
+    // Worker threads check the pool without a lock: it can't change under
+    // them.
+    if (outstanding != 0 || ReadsInFlight() != 0) {
+        Nan::ThrowError("cannot change the transform pool with reads in "
+                        "flight");
+        return;
+    }
+
+    if (!async_initialized) {
+        uv_async_init(uv_default_loop(), &async, OnAsync);
+        uv_unref(reinterpret_cast<uv_handle_t *>(&async));
+        async_initialized = true;
+    }
+
+    StopPool();
+    min_transform_size = min_size;
+    if (!disable && !StartPool(threads)) {
+        char msg[256];
+        snprintf(msg, sizeof(msg), "cannot start transform threads: %s",
+                 strerror(errno));
+        Nan::ThrowError(msg);
+        return;
+    }
+}
+
+NAN_METHOD(TransformPoolStats) {
+    size_t queued = 0;
+    for (size_t i = 0; i < pool.size(); i++) {
+        pthread_mutex_lock(&pool[i]->lock);
+        queued += pool[i]->queue.size();
+        pthread_mutex_unlock(&pool[i]->lock);
+    }
+
+    pthread_mutex_lock(&lock);
+    uint64_t n_transforms = transforms, n_steals = steals;
+    pthread_mutex_unlock(&lock);
+
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+    result->Set(Nan::New<v8::String>("threads").ToLocalChecked(),
+                Nan::New<v8::Number>(pool.size()));
+    result->Set(Nan::New<v8::String>("queuedTransforms").ToLocalChecked(),
+                Nan::New<v8::Number>(queued));
+    result->Set(Nan::New<v8::String>("transforms").ToLocalChecked(),
+                Nan::New<v8::Number>(n_transforms));
+    result->Set(Nan::New<v8::String>("steals").ToLocalChecked(),
+                Nan::New<v8::Number>(n_steals));
+    info.GetReturnValue().Set(result);
+}
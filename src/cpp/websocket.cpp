@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+#include "websocket.h"
+
+/*
+ * Size of the header, knowing only its first 2 bytes.
+ */
+size_t WebSocketHeaderSize(const char *data) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    size_t size = 2;
+
+    if ((bytes[1] & 0x7f) == 126)
+        size += 2;
+    else if ((bytes[1] & 0x7f) == 127)
+        size += 8;
+    if (bytes[1] & 0x80)
+        size += 4;
+
+    return size;
+}
+
+/*
+ * Decode a complete header (WebSocketHeaderSize() bytes). Returns false if it
+ * is invalid: a 64-bit length with its most significant bit set, or a control
+ * frame that is fragmented or longer than 125 bytes.
+ */
+bool WebSocketParseHeader(const char *data, WebSocketHeader *header) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+
+    header->fin = bytes[0] & 0x80;
+    header->rsv = (bytes[0] >> 4) & 0x07;
+    header->opcode = bytes[0] & 0x0f;
+    header->masked = bytes[1] & 0x80;
+    header->size = WebSocketHeaderSize(data);
+
+    size_t offset = 2;
+    header->payload_length = bytes[1] & 0x7f;
+    if (header->payload_length == 126) {
+        header->payload_length = (bytes[2] << 8) | bytes[3];
+        offset += 2;
+    } else if (header->payload_length == 127) {
+        header->payload_length = 0;
+        for (size_t i = 0; i < 8; i++)
+            header->payload_length = (header->payload_length << 8) |
+                                     bytes[2 + i];
+        if (header->payload_length >> 63)
+            return false;
+        offset += 8;
+    }
+
+    if (header->masked)
+        memcpy(header->mask, &bytes[offset], 4);
+
+    // Control frames: close, ping, pong
+    if (header->opcode & 0x08 && (!header->fin ||
+                                  header->payload_length > 125))
+        return false;
+
+    return true;
+}
+
+/*
+ * XOR the payload with the masking key, 16 bytes at a time with SSE2, or 8
+ * bytes at a time otherwise. Byte `i` of the payload is XORed with byte
+ * `i % 4` of the key.
+ */
+void WebSocketUnmask(char *data, size_t size, const unsigned char mask[4]) {
+    unsigned char *bytes = reinterpret_cast<unsigned char *>(data);
+    size_t i = 0;
+
+    // The key repeated to fill a word; memcpy keeps the byte order right on
+    // any endianness.
+    unsigned char pattern[16];
+    for (size_t j = 0; j < sizeof(pattern); j++)
+        pattern[j] = mask[j % 4];
+
+#ifdef __SSE2__
+    __m128i wide = _mm_loadu_si128(reinterpret_cast<__m128i *>(pattern));
+    for (; i + 16 <= size; i += 16) {
+        __m128i *block = reinterpret_cast<__m128i *>(&bytes[i]);
+        _mm_storeu_si128(block,
+                         _mm_xor_si128(_mm_loadu_si128(block), wide));
+    }
+#endif
+
+    uint64_t word;
+    memcpy(&word, pattern, sizeof(word));
+    for (; i + 8 <= size; i += 8) {
+        uint64_t block;
+        memcpy(&block, &bytes[i], sizeof(block));
+        block ^= word;
+        memcpy(&bytes[i], &block, sizeof(block));
+    }
+
+    for (; i < size; i++)
+        bytes[i] ^= mask[i % 4];
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2015 Adrien Vergé
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef WEBSOCKET_H
+# define WEBSOCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Frame header of the WebSocket protocol (RFC 6455, section 5.2).
+ */
+struct WebSocketHeader {
+    bool fin;
+    unsigned int rsv;     // the 3 reserved bits, used by extensions
+    unsigned int opcode;
+    bool masked;
+    unsigned char mask[4];
+    uint64_t payload_length;
+    size_t size;          // of the header itself, 2 to 14 bytes
+};
+
+size_t WebSocketHeaderSize(const char *data);
+bool WebSocketParseHeader(const char *data, WebSocketHeader *header);
+void WebSocketUnmask(char *data, size_t size, const unsigned char mask[4]);
+
+#endif /* WEBSOCKET_H */
@@ -0,0 +1,70 @@
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.startCapture()', () => {
+    it('should copy consumed data to the capture file', (done) => {
+        const file = path.join(os.tmpdir(),
+                               `posix-read-test-${process.pid}-cap`);
+        const fd = fs.openSync(file, 'w');
+
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write('ABCDEFGHIJKLMNOPQRSTUVWXYZ', () => {
+                posixRead.startCapture(fd, {});
+                posixRead(socket, 10, (err) => {
+                    if (err)
+                        return done(err);
+
+                    posixRead.stopCapture(() => {
+                        fs.closeSync(fd);
+
+                        const stats = posixRead.captureStats();
+                        assert.strictEqual(stats.capturedBytes, 10);
+                        assert.strictEqual(stats.droppedBytes, 0);
+                        assert.strictEqual(stats.queuedBytes, 0);
+
+                        const capture = fs.readFileSync(file);
+                        fs.unlinkSync(file);
+                        assert.strictEqual(capture.toString('ascii', 0, 8),
+                                           'PRCAPv1\n');
+                        // The first connection, whatever its fd
+                        assert.strictEqual(capture.readUInt32LE(16), 0);
+                        assert.strictEqual(capture.readUInt32LE(20), 10);
+                        assert.strictEqual(capture.toString('ascii', 24),
+                                           'ABCDEFGHIJ');
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should drop data beyond maxQueuedBytes', (done) => {
+        const fd = fs.openSync('/dev/null', 'w');
+
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write('ABCDEFGHIJKLMNOPQRSTUVWXYZ', () => {
+                posixRead.startCapture(fd, { maxQueuedBytes: 5 });
+                posixRead(socket, 10, (err) => {
+                    if (err)
+                        return done(err);
+
+                    posixRead.stopCapture(() => {
+                        fs.closeSync(fd);
+                        assert.strictEqual(
+                            posixRead.captureStats().droppedBytes, 10);
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should call back even when no capture is running', (done) => {
+        posixRead.stopCapture(done);
+    });
+});
@@ -0,0 +1,81 @@
+const assert = require('assert');
+const fs = require('fs');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.trackHeavyHitters()', () => {
+    afterEach(() => {
+        posixRead.trackHeavyHitters(null);
+    });
+
+    it('should detect bad first argument', (done) => {
+        try {
+            posixRead.trackHeavyHitters({ k: 0 });
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'first argument should be an object ' +
+                                       'with valid options, or null')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should detect bad metric', (done) => {
+        try {
+            posixRead.heavyHitters('time');
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'first argument should be \'bytes\', ' +
+                                       '\'reads\' or \'blockedMs\'')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should count bytes and reads by tag', (done) => {
+        posixRead.trackHeavyHitters({ k: 4 });
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead.setHeavyHitterTag(socket, 'client-a');
+            otherEnd.write('abcdef');
+
+            posixRead(socket, 2, (err) => {
+                if (err)
+                    return done(err);
+
+                posixRead(socket, 4, (err) => {
+                    posixRead.setHeavyHitterTag(socket, null);
+                    if (err)
+                        return done(err);
+
+                    const bytes = posixRead.heavyHitters('bytes');
+                    assert.deepStrictEqual(bytes[0],
+                                           { tag: 'client-a', value: 6,
+                                             error: 0 });
+                    const reads = posixRead.heavyHitters('reads');
+                    assert.strictEqual(reads[0].tag, 'client-a');
+                    assert.strictEqual(reads[0].value, 2);
+                    assert(posixRead.heavyHitters('blockedMs').length >= 1);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should count readRanges() as issued reads', (done) => {
+        posixRead.trackHeavyHitters({ k: 4 });
+        const fd = fs.openSync(__filename, 'r');
+
+        posixRead.readRanges(fd, [[0, 5], [10, 5]], (err) => {
+            fs.closeSync(fd);
+            if (err)
+                return done(err);
+
+            assert.deepStrictEqual(posixRead.heavyHitters('reads'),
+                                   [{ fd, value: 1, error: 0 }]);
+            done();
+        });
+    });
+});
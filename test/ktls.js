@@ -0,0 +1,39 @@
+const assert = require('assert');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.enableKtlsRx()', () => {
+    it('should detect bad second argument', (done) => {
+        getNewSocket(function onSocket(socket) {
+            try {
+                posixRead.enableKtlsRx(socket, {
+                    version: 'TLSv1.3',
+                    cipher: 'aes-128-gcm',
+                    key: new Buffer(32),  // should be 16 bytes
+                    iv: new Buffer(12),
+                });
+                done(new Error('error not thrown'));
+            } catch (err) {
+                if (err instanceof TypeError
+                        && err.message === 'second argument should be an ' +
+                                           'object with valid TLS parameters')
+                    return done();
+                return done(err);
+            }
+        });
+    });
+});
+
+describe('posixRead.ktlsKeysFromSecret()', () => {
+    it('should derive TLS 1.3 keys', () => {
+        // From RFC 8448, section 3 (server handshake traffic keys)
+        const secret = new Buffer('b67b7d690cc16c4e75e54213cb2d37b4' +
+                                  'e9c912bcded9105d42befd59d391ad38', 'hex');
+        const keys = posixRead.ktlsKeysFromSecret('aes-128-gcm', secret);
+        assert.strictEqual(keys.key.toString('hex'),
+                           '3fce516009c21727d0f2e4e86ee403bc');
+        assert.strictEqual(keys.iv.toString('hex'),
+                           '5d313eb2671276ee13000b30');
+    });
+});
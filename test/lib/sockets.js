@@ -0,0 +1,31 @@
+const net = require('net');
+
+/*
+ * Create a pair of connected sockets. The first one is paused on connection,
+ * so that it can be read from with posix-read.
+ */
+function getNewSocket(callback) {
+    const otherEnd = new net.Socket();
+
+    const server = net.createServer(
+        { pauseOnConnect: true },
+        function onConnection(socket) {
+            server.close();
+
+            // Make sure otherEnd is also ready
+            if (otherEnd.readable)
+                callback(socket, otherEnd);
+            else
+                otherEnd.on('connect', () => {
+                    callback(socket, otherEnd);
+                });
+            // otherEnd.end();
+            // otherEnd.destroy();
+        });
+
+    server.listen(function onListening() {
+        otherEnd.connect(server.address().port);
+    });
+}
+
+module.exports.getNewSocket = getNewSocket;
@@ -0,0 +1,68 @@
+const assert = require('assert');
+const net = require('net');
+
+const posixRead = require('../index');
+
+describe('posixRead.listen()', () => {
+    it('should detect bad options', (done) => {
+        try {
+            posixRead.listen({ port: 'http' }, () => {});
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'first argument should be an object ' +
+                                       'with valid options')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should accept connections and read their first bytes', (done) => {
+        const options = { host: '127.0.0.1', firstRead: 5 };
+        const listener = posixRead.listen(options, (err, socket, first) => {
+            if (err)
+                return done(err);
+            listener.close();
+
+            assert.deepStrictEqual(first, new Buffer('Hello'));
+
+            // The rest is left in the socket, which is paused
+            posixRead(socket, 7, (err, buffer) => {
+                if (err)
+                    return done(err);
+
+                assert.deepStrictEqual(buffer, new Buffer(', world'));
+                socket.destroy();
+                done();
+            });
+        });
+
+        const client = net.connect(listener.port, '127.0.0.1', () => {
+            client.end('Hello, world');
+        });
+    });
+
+    it('should peek the first bytes when asked', (done) => {
+        const options = { host: '127.0.0.1', firstRead: 4, peek: true };
+        const listener = posixRead.listen(options, (err, socket, first) => {
+            if (err)
+                return done(err);
+            listener.close();
+
+            assert.deepStrictEqual(first, new Buffer('GET '));
+
+            posixRead(socket, 4, (err, buffer) => {
+                if (err)
+                    return done(err);
+
+                assert.deepStrictEqual(buffer, new Buffer('GET '));
+                socket.destroy();
+                done();
+            });
+        });
+
+        const client = net.connect(listener.port, '127.0.0.1', () => {
+            client.end('GET / HTTP/1.1\r\n\r\n');
+        });
+    });
+});
@@ -0,0 +1,93 @@
+const assert = require('assert');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.watchMemoryPressure()', () => {
+    it('should detect bad first argument', (done) => {
+        try {
+            posixRead.watchMemoryPressure({ windowMs: 20000 }, () => {});
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'first argument should be an object ' +
+                                       'with valid options')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should report statistics', () => {
+        const stats = posixRead.memoryPressureStats();
+        assert.strictEqual(stats.events, 0);
+        assert.strictEqual(stats.reclaimedBytes, 0);
+        assert.strictEqual(stats.underPressure, false);
+    });
+});
+
+describe('posixRead.simulateMemoryPressure()', () => {
+    // Watching needs pressure stall information (Linux 4.20+).
+    beforeEach(function checkPsi() {
+        try {
+            posixRead.watchMemoryPressure({ maxNewReads: 1,
+                                            cooldownMs: 60000 }, () => {});
+        } catch (err) {
+            this.skip();
+        }
+    });
+
+    afterEach(() => {
+        posixRead.unwatchMemoryPressure();
+    });
+
+    it('should only admit maxNewReads more reads', (done) => {
+        getNewSocket(function onFirst(first, firstEnd) {
+            getNewSocket(function onSecond(second, secondEnd) {
+                posixRead.simulateMemoryPressure();
+                assert.strictEqual(posixRead.memoryPressureStats()
+                                       .underPressure, true);
+
+                const order = [];
+                posixRead(first, 1, (err) => {
+                    if (err)
+                        return done(err);
+                    order.push('first');
+                });
+                secondEnd.write('b', () => {
+                    posixRead(second, 1, (err) => {
+                        if (err)
+                            return done(err);
+
+                        // It had to wait for the first one.
+                        order.push('second');
+                        assert.deepStrictEqual(order, ['first', 'second']);
+                        done();
+                    });
+                    assert.strictEqual(
+                        posixRead.rateLimitStats().waitingReads, 1);
+                    setTimeout(() => firstEnd.write('a'), 50);
+                });
+            });
+        });
+    });
+
+    it('should trim the small result pool', (done) => {
+        posixRead.unwatchMemoryPressure();
+        posixRead.watchMemoryPressure({}, (err, event) => {
+            if (err)
+                return done(err);
+
+            assert(event.trimmedPoolBytes > 0);
+            done();
+        });
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write('abcd');
+            posixRead(socket, 4, (err) => {
+                if (err)
+                    return done(err);
+
+                posixRead.simulateMemoryPressure();
+            });
+        });
+    });
+});
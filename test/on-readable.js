@@ -0,0 +1,69 @@
+const assert = require('assert');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.onReadable()', () => {
+    it('should detect bad options', (done) => {
+        getNewSocket(function onSocket(socket) {
+            try {
+                posixRead.onReadable(socket, { events: ['foo'] }, () => {});
+                done(new Error('error not thrown'));
+            } catch (err) {
+                if (err instanceof TypeError
+                        && err.message === 'second argument should be an ' +
+                                           'object with valid events')
+                    return done();
+                return done(err);
+            }
+        });
+    });
+
+    it('should fire when data arrives, without reading it', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead.onReadable(socket, {}, (err, events) => {
+                if (err)
+                    return done(err);
+
+                assert.strictEqual(events.readable, true);
+                assert.strictEqual(events.hangup, false);
+
+                posixRead(socket, 5, (err, buffer) => {
+                    if (err)
+                        return done(err);
+
+                    assert.deepStrictEqual(buffer, new Buffer('Hello'));
+                    done();
+                });
+            });
+            setTimeout(() => {
+                otherEnd.write('Hello');
+            }, 10);
+        });
+    });
+
+    it('should fire when the peer closes', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead.onReadable(socket, { events: ['hangup'] }, (err) => {
+                if (err)
+                    return done(err);
+                done();
+            });
+            otherEnd.end();
+        });
+    });
+
+    it('should refuse a socket that Node is reading', (done) => {
+        getNewSocket(function onSocket(socket) {
+            socket.resume();
+            setImmediate(() => {
+                posixRead.onReadable(socket, {}, (err) => {
+                    if (!err)
+                        return done(new Error('error not raised'));
+                    assert.strictEqual(err.badStream, true);
+                    done();
+                });
+            });
+        });
+    });
+});
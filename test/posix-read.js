@@ -3,6 +3,7 @@ const crypto = require('crypto');
 const net = require('net');
 
 const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
 
 describe('posixRead()', () => {
     it('should detect non-socket objects (undefined)', (done) => {
@@ -54,30 +55,6 @@ describe('posixRead()', () => {
         });
     });
 
-    function getNewSocket(callback) {
-        const otherEnd = new net.Socket();
-
-        const server = net.createServer(
-            { pauseOnConnect: true },
-            function onConnection(socket) {
-                server.close();
-
-                // Make sure otherEnd is also ready
-                if (otherEnd.readable)
-                    callback(socket, otherEnd);
-                else
-                    otherEnd.on('connect', () => {
-                        callback(socket, otherEnd);
-                    });
-                // otherEnd.end();
-                // otherEnd.destroy();
-            });
-
-        server.listen(function onListening() {
-            otherEnd.connect(server.address().port);
-        });
-    }
-
     it('should detect bad socket (invalid handle)', (done) => {
         getNewSocket(function onSocket(socket) {
             socket._handle = {};
@@ -184,6 +161,39 @@ describe('posixRead()', () => {
         });
     });
 
+    it('should give error code on end of stream', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.end('123', () => {
+                posixRead(socket, 10, (err) => {
+                    if (!err)
+                        return done(new Error('error not thrown'));
+                    if (!(err instanceof Error) || err.code !== 'EOF')
+                        return done(err);
+
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should report plain error descriptors in fast mode', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.end('123', () => {
+                posixRead.setFastErrors(true);
+                posixRead(socket, 10, (err) => {
+                    posixRead.setFastErrors(false);
+
+                    if (!err)
+                        return done(new Error('error not thrown'));
+                    assert(!(err instanceof Error));
+                    assert.strictEqual(err.endOfFile, true);
+                    assert.strictEqual(err.code, 'EOF');
+                    done();
+                });
+            });
+        });
+    });
+
     it('should wait for data to be available', (done) => {
         getNewSocket(function onSocket(socket, otherEnd) {
             posixRead(socket, 10, (err, buffer) => {
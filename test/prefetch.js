@@ -0,0 +1,46 @@
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const posixRead = require('../index');
+
+describe('posixRead.prefetch()', () => {
+    const file = path.join(os.tmpdir(), `posix-read-test-${process.pid}-pf`);
+    fs.writeFileSync(file, new Buffer(100000));
+    const fd = fs.openSync(file, 'r');
+
+    after(() => {
+        fs.closeSync(fd);
+        fs.unlinkSync(file);
+    });
+
+    it('should detect bad ranges', (done) => {
+        try {
+            posixRead.prefetch(fd, []);
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'second argument should be an array ' +
+                                       'of [offset, length] pairs')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should report completion', (done) => {
+        posixRead.prefetch(fd, [[0, 4096], [50000, 50000]], done);
+    });
+
+    it('should let the callback close the fd', (done) => {
+        const own = fs.openSync(file, 'r');
+        posixRead.prefetch(own, [[0, 100000]], (err) => {
+            fs.closeSync(own);
+            done(err);
+        });
+    });
+
+    it('should work without callback', () => {
+        // Nothing reports completion: only check that queuing doesn't throw.
+        posixRead.prefetch(fd, [[0, 100000]]);
+    });
+});
@@ -0,0 +1,94 @@
+const assert = require('assert');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.setRateLimit()', () => {
+    it('should detect bad second argument', (done) => {
+        try {
+            posixRead.setRateLimit('tenant', { bytesPerSecond: -1 });
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'second argument should be an object ' +
+                                       'with valid limits, or null')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should delay reads beyond the limit', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead.setRateLimit(socket, { readsPerSecond: 10,
+                                             burstReads: 1 });
+            otherEnd.write('abcd', () => {
+                const start = Date.now();
+                posixRead(socket, 2, (err) => {
+                    if (err)
+                        return done(err);
+
+                    posixRead(socket, 2, (err, buffer) => {
+                        posixRead.setRateLimit(socket, null);
+                        if (err)
+                            return done(err);
+
+                        assert.strictEqual(buffer.toString(), 'cd');
+                        assert(Date.now() - start >= 80);
+                        assert(posixRead.rateLimitStats().delayedReads >= 1);
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should share the limit of a group', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead.setRateLimit('test-group', { bytesPerSecond: 1000,
+                                                   burstBytes: 1 });
+            posixRead.setRateLimitGroup(socket, 'test-group');
+            otherEnd.write(new Buffer(200), () => {
+                const start = Date.now();
+                posixRead(socket, 100, (err) => {
+                    if (err)
+                        return done(err);
+
+                    // 100 bytes of debt at 1000 bytes per second
+                    posixRead(socket, 100, (err) => {
+                        posixRead.setRateLimitGroup(socket, null);
+                        posixRead.setRateLimit('test-group', null);
+                        if (err)
+                            return done(err);
+
+                        assert(Date.now() - start >= 80);
+                        done();
+                    });
+                });
+            });
+        });
+    });
+});
+
+describe('posixRead.setRateLimit() on closed sockets', () => {
+    it('should fail reads still waiting when the socket closes', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead.setRateLimit(socket, { readsPerSecond: 1,
+                                             burstReads: 1 });
+            otherEnd.write('ab', () => {
+                posixRead(socket, 1, (err) => {
+                    if (err)
+                        return done(err);
+
+                    posixRead(socket, 1, (err) => {
+                        assert(err);
+                        assert.strictEqual(err.badStream, true);
+                        assert.strictEqual(
+                            posixRead.rateLimitStats().waitingReads, 0);
+                        done();
+                    });
+                    socket.destroy();
+                });
+            });
+        });
+    });
+});
@@ -0,0 +1,105 @@
+const assert = require('assert');
+const fs = require('fs');
+const net = require('net');
+const os = require('os');
+const path = require('path');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.readAny()', () => {
+    it('should detect bad first argument', (done) => {
+        try {
+            posixRead.readAny([], 8, () => {});
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'first argument should be an array ' +
+                                       'of sockets')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should read from the first socket with enough data', (done) => {
+        getNewSocket(function onFirst(first, firstEnd) {
+            getNewSocket(function onSecond(second, secondEnd) {
+                firstEnd.write('abc', () => {
+                    secondEnd.write('01234567', () => {
+                        posixRead.readAny([first, second], 8,
+                                          (err, buffer, index) => {
+                            if (err)
+                                return done(err);
+
+                            assert.strictEqual(index, 1);
+                            assert.strictEqual(buffer.toString(), '01234567');
+
+                            // The first socket must not have been touched
+                            posixRead(first, 3, (err, buffer) => {
+                                if (err)
+                                    return done(err);
+
+                                assert.strictEqual(buffer.toString(), 'abc');
+                                done();
+                            });
+                        });
+                    });
+                });
+            });
+        });
+    });
+
+    it('should refuse sockets that ignore SO_RCVLOWAT', (done) => {
+        const socketPath = path.join(os.tmpdir(),
+                                     `posix-read-any-${process.pid}.sock`);
+        if (fs.existsSync(socketPath))
+            fs.unlinkSync(socketPath);
+        const server = net.createServer({ pauseOnConnect: true }, (unix) => {
+            server.close();
+            getNewSocket(function onSocket(tcp) {
+                posixRead.readAny([tcp, unix], 8, (err, buffer, index) => {
+                    assert.strictEqual(err.badStream, true);
+                    assert.strictEqual(index, 1);
+                    unix.destroy();
+                    done();
+                });
+            });
+        });
+        server.listen(socketPath, () => net.connect(socketPath));
+    });
+
+    it('should refuse a socket already waited on', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead.readAny([socket, socket], 8, (err, buffer, index) => {
+                assert.strictEqual(err.badStream, true);
+                assert.strictEqual(index, 1);
+
+                // The socket must still be readable
+                otherEnd.write('abc', () => {
+                    posixRead(socket, 3, (err, buffer) => {
+                        if (err)
+                            return done(err);
+
+                        assert.strictEqual(buffer.toString(), 'abc');
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should report the socket that ended', (done) => {
+        getNewSocket(function onFirst(first, firstEnd) {
+            getNewSocket(function onSecond(second) {
+                firstEnd.end('abc', () => {
+                    posixRead.readAny([second, first], 8,
+                                      (err, buffer, index) => {
+                        assert.strictEqual(err.endOfFile, true);
+                        assert.strictEqual(index, 1);
+                        done();
+                    });
+                });
+            });
+        });
+    });
+});
@@ -0,0 +1,109 @@
+const assert = require('assert');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+const BODY = '4\r\nWiki\r\n5;ext=1\r\npedia\r\nE\r\n in\r\n\r\nchunks.\r\n' +
+             '0\r\nExpires: never\r\n\r\n';
+
+describe('posixRead.readChunked()', () => {
+    it('should detect bad second argument', (done) => {
+        getNewSocket(function onSocket(socket) {
+            try {
+                posixRead.readChunked(socket, { chunks: 1 }, () => {});
+                done(new Error('error not thrown'));
+            } catch (err) {
+                if (err instanceof TypeError
+                        && err.message === 'second argument should be an ' +
+                                           'object with valid options')
+                    return done();
+                return done(err);
+            }
+        });
+    });
+
+    it('should read exactly the body and its trailers', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            // Send it in pieces, followed by the next request
+            otherEnd.write(BODY.slice(0, 10));
+            setTimeout(() => {
+                otherEnd.write(BODY.slice(10) + 'GET / HTTP/1.1\r\n');
+            }, 10);
+
+            posixRead.readChunked(socket, {}, (err, body, trailers) => {
+                if (err)
+                    return done(err);
+
+                assert.strictEqual(body.toString(),
+                                   'Wikipedia in\r\n\r\nchunks.');
+                assert.strictEqual(trailers.toString(),
+                                   'Expires: never\r\n');
+
+                posixRead(socket, 3, (err, buffer) => {
+                    if (err)
+                        return done(err);
+
+                    assert.strictEqual(buffer.toString(), 'GET');
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should return chunks separately if asked', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write(BODY, () => {
+                posixRead.readChunked(socket, { chunks: true },
+                                      (err, chunks, trailers) => {
+                    if (err)
+                        return done(err);
+
+                    assert.deepStrictEqual(
+                        chunks.map((chunk) => chunk.toString()),
+                        ['Wiki', 'pedia', ' in\r\n\r\nchunks.']);
+                    assert.strictEqual(trailers.length, 16);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should reject invalid encoding', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write('4\r\nWikiXX', () => {
+                posixRead.readChunked(socket, {}, (err) => {
+                    assert.strictEqual(err.badChunk, true);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should refuse bodies larger than maxBytes', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write('1000\r\n', () => {
+                posixRead.readChunked(socket, { maxBytes: 100 }, (err) => {
+                    assert.strictEqual(err.bodyTooLarge, true);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should read bodies larger than its first buffer', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            // 10 chunks of 3000 bytes
+            otherEnd.write(`bb8\r\n${'a'.repeat(3000)}\r\n`.repeat(10) +
+                           '0\r\n\r\n');
+
+            posixRead.readChunked(socket, {}, (err, body) => {
+                if (err)
+                    return done(err);
+
+                assert.strictEqual(body.length, 30000);
+                assert.strictEqual(body.toString().replace(/a/g, ''), '');
+                done();
+            });
+        });
+    });
+});
@@ -0,0 +1,163 @@
+const assert = require('assert');
+const crypto = require('crypto');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+function frame(payload) {
+    const prefix = new Buffer(4);
+    prefix.writeUInt32BE(payload.length, 0);
+    return Buffer.concat([prefix, new Buffer(payload)]);
+}
+
+function encryptedFrame(algorithm, key, plaintext) {
+    const nonce = crypto.randomBytes(12);
+    const prefix = new Buffer(4);
+    prefix.writeUInt32BE(12 + plaintext.length + 16, 0);
+
+    const cipher = crypto.createCipheriv(algorithm, key, nonce,
+                                         { authTagLength: 16 });
+    cipher.setAAD(prefix);
+    const ciphertext = Buffer.concat([cipher.update(plaintext),
+                                      cipher.final()]);
+
+    return Buffer.concat([prefix, nonce, ciphertext, cipher.getAuthTag()]);
+}
+
+// 'abc' followed by a 9-byte match at offset 3, then 'x'
+const lz4Payload = new Buffer([13, 0, 0, 0,
+                               0x35, 0x61, 0x62, 0x63, 0x03, 0x00,
+                               0x10, 0x78]);
+
+describe('posixRead.readFrame()', () => {
+    it('should detect bad options', (done) => {
+        getNewSocket(function onSocket(socket) {
+            try {
+                posixRead.readFrame(socket, 'UInt32BE',
+                                    { decompress: 'gzip' }, () => {});
+                done(new Error('error not thrown'));
+            } catch (err) {
+                if (err instanceof TypeError
+                        && err.message === 'third argument should be an ' +
+                                           'object with valid options')
+                    return done();
+                return done(err);
+            }
+        });
+    });
+
+    it('should read exactly one frame', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            const data = Buffer.concat([frame('Hello'), frame('world')]);
+            otherEnd.write(data, () => {
+                posixRead.readFrame(socket, 'UInt32BE', {}, (err, payload) => {
+                    if (err)
+                        return done(err);
+
+                    assert.deepStrictEqual(payload, new Buffer('Hello'));
+
+                    posixRead(socket, 9, (err, buffer) => {
+                        if (err)
+                            return done(err);
+
+                        assert.deepStrictEqual(buffer, frame('world'));
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should decompress LZ4 frames', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write(frame(lz4Payload), () => {
+                const options = { decompress: 'lz4' };
+                posixRead.readFrame(socket, 'UInt32BE', options,
+                                    (err, payload) => {
+                    if (err)
+                        return done(err);
+
+                    assert.deepStrictEqual(payload,
+                                           new Buffer('abcabcabcabcx'));
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should detect invalid LZ4 frames', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write(frame(lz4Payload.slice(0, 9)), () => {
+                const options = { decompress: 'lz4' };
+                posixRead.readFrame(socket, 'UInt32BE', options, (err) => {
+                    if (!err)
+                        return done(new Error('error not thrown'));
+                    if (err.badFrame !== true)
+                        return done(err);
+                    done();
+                });
+            });
+        });
+    });
+
+    ['aes-256-gcm', 'chacha20-poly1305'].forEach((algorithm) => {
+        it(`should decrypt ${algorithm} frames`, (done) => {
+            getNewSocket(function onSocket(socket, otherEnd) {
+                const key = crypto.randomBytes(32);
+                const data = encryptedFrame(algorithm, key,
+                                            new Buffer('secret message'));
+                otherEnd.write(data, () => {
+                    const options = { decrypt: { algorithm, key } };
+                    posixRead.readFrame(socket, 'UInt32BE', options,
+                                        (err, payload) => {
+                        if (err)
+                            return done(err);
+
+                        assert.deepStrictEqual(payload,
+                                               new Buffer('secret message'));
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should detect tampered frames', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            const key = crypto.randomBytes(32);
+            const data = encryptedFrame('aes-256-gcm', key,
+                                        new Buffer('secret message'));
+            data[20] ^= 1;
+            otherEnd.write(data, () => {
+                const options = { decrypt: { algorithm: 'aes-256-gcm', key } };
+                posixRead.readFrame(socket, 'UInt32BE', options, (err) => {
+                    if (!err)
+                        return done(new Error('error not thrown'));
+                    if (err.authFailed !== true)
+                        return done(err);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should not consume frames larger than maxBytes', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write(frame(new Buffer(1000)), () => {
+                const options = { maxBytes: 100 };
+                posixRead.readFrame(socket, 'UInt32BE', options, (err) => {
+                    if (!err || err.frameTooLarge !== true)
+                        return done(err || new Error('error not thrown'));
+
+                    posixRead.readUInt32(socket, 'BE', (err, length) => {
+                        if (err)
+                            return done(err);
+
+                        assert.strictEqual(length, 1000);
+                        done();
+                    });
+                });
+            });
+        });
+    });
+});
@@ -0,0 +1,108 @@
+const assert = require('assert');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+function frame(payload) {
+    const prefix = new Buffer(2);
+    prefix.writeUInt16BE(payload.length, 0);
+    return Buffer.concat([prefix, new Buffer(payload)]);
+}
+
+describe('posixRead.readFrames()', () => {
+    it('should detect bad prefix type', (done) => {
+        getNewSocket(function onSocket(socket) {
+            try {
+                posixRead.readFrames(socket, 'UInt24', {}, () => {});
+                done(new Error('error not thrown'));
+            } catch (err) {
+                if (err instanceof TypeError
+                        && err.message === 'second argument should be a ' +
+                                           'prefix type')
+                    return done();
+                return done(err);
+            }
+        });
+    });
+
+    it('should read all complete frames, and only them', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            const data = Buffer.concat([
+                frame('Hello'), frame(''), frame('world'),
+                frame('incomplete').slice(0, 6)]);
+            otherEnd.write(data, () => {
+                posixRead.readFrames(socket, 'UInt16BE', {}, (err, frames) => {
+                    if (err)
+                        return done(err);
+
+                    assert.deepStrictEqual(frames, [
+                        new Buffer('Hello'), new Buffer(''),
+                        new Buffer('world')]);
+
+                    posixRead(socket, 6, (err, buffer) => {
+                        if (err)
+                            return done(err);
+
+                        assert.deepStrictEqual(
+                            buffer, frame('incomplete').slice(0, 6));
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should respect maxFrames', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            const data = Buffer.concat([frame('a'), frame('b'), frame('c')]);
+            otherEnd.write(data, () => {
+                const options = { maxFrames: 2 };
+                posixRead.readFrames(socket, 'UInt16BE', options,
+                                     (err, frames) => {
+                    if (err)
+                        return done(err);
+
+                    assert.deepStrictEqual(
+                        frames, [new Buffer('a'), new Buffer('b')]);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should wait for a complete frame', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead.readFrames(socket, 'UInt16BE', {}, (err, frames) => {
+                if (err)
+                    return done(err);
+
+                assert.deepStrictEqual(frames, [new Buffer('0123456789')]);
+                done();
+            });
+            const data = frame('0123456789');
+            otherEnd.write(data.slice(0, 1));
+            setTimeout(() => {
+                otherEnd.write(data.slice(1, 5));
+            }, 10);
+            setTimeout(() => {
+                otherEnd.write(data.slice(5));
+            }, 20);
+        });
+    });
+
+    it('should detect frames larger than maxBytes', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write(frame(new Buffer(1000)), () => {
+                const options = { maxBytes: 100 };
+                posixRead.readFrames(socket, 'UInt16BE', options, (err) => {
+                    if (!err)
+                        return done(new Error('error not thrown'));
+                    if (err.frameTooLarge !== true
+                            || err.message !== 'frame too large (1002 bytes)')
+                        return done(err);
+                    done();
+                });
+            });
+        });
+    });
+});
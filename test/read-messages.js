@@ -0,0 +1,210 @@
+const assert = require('assert');
+const fs = require('fs');
+const net = require('net');
+const os = require('os');
+const path = require('path');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+/*
+ * Create a pair of connected Unix stream sockets, the first one paused.
+ */
+function getNewUnixSocket(callback) {
+    const socketPath = path.join(os.tmpdir(),
+                                 `posix-read-test-${process.pid}.sock`);
+    const otherEnd = new net.Socket();
+
+    if (fs.existsSync(socketPath))
+        fs.unlinkSync(socketPath);
+
+    const server = net.createServer(
+        { pauseOnConnect: true },
+        function onConnection(socket) {
+            server.close();
+            callback(socket, otherEnd);
+        });
+
+    server.listen(socketPath, function onListening() {
+        otherEnd.connect(socketPath);
+    });
+}
+
+describe('posixRead.readMessages()', () => {
+    it('should detect bad first argument', () => {
+        try {
+            posixRead.readMessages('socket', {}, () => {});
+            throw new Error('error not thrown');
+        } catch (err) {
+            assert(err instanceof TypeError);
+            assert.strictEqual(err.message, 'first argument should be a ' +
+                                             'socket or a file descriptor');
+        }
+    });
+
+    it('should detect bad second argument', (done) => {
+        getNewSocket(function onSocket(socket) {
+            try {
+                posixRead.readMessages(socket, { maxMessages: 0 }, () => {});
+                done(new Error('error not thrown'));
+            } catch (err) {
+                if (err instanceof TypeError
+                        && err.message === 'second argument should be an ' +
+                                           'object with valid options')
+                    return done();
+                return done(err);
+            }
+        });
+    });
+
+    it('should refuse a TCP socket', (done) => {
+        getNewSocket(function onSocket(socket) {
+            posixRead.readMessages(socket, {}, (err) => {
+                assert(err);
+                assert.strictEqual(err.badStream, true);
+                assert.strictEqual(err.message,
+                                   'not a message-oriented socket');
+                done();
+            });
+        });
+    });
+
+    it('should take a Unix socket, and refuse a stream one', (done) => {
+        getNewUnixSocket(function onSocket(socket, otherEnd) {
+            posixRead.readMessages(socket, {}, (err) => {
+                assert(err);
+                assert.strictEqual(err.badStream, true);
+                assert.strictEqual(err.message,
+                                   'not a message-oriented socket');
+                otherEnd.destroy();
+                socket.destroy();
+                done();
+            });
+        });
+    });
+
+    describe('on SOCK_SEQPACKET sockets', () => {
+        const fds = [];
+
+        beforeEach(() => {
+            const pair = posixRead.seqpacketPair();
+            fds[0] = pair[0];
+            fds[1] = pair[1];
+        });
+
+        afterEach(() => {
+            fds.forEach((fd) => {
+                try {
+                    fs.closeSync(fd);
+                } catch (err) {
+                    // already closed by the test
+                }
+            });
+        });
+
+        it('should read exactly one message', (done) => {
+            fs.writeSync(fds[1], new Buffer('hello'));
+            fs.writeSync(fds[1], new Buffer('world!'));
+
+            posixRead.readMessages(fds[0], {}, (err, messages) => {
+                if (err)
+                    return done(err);
+
+                assert.deepStrictEqual(messages.map(String), ['hello']);
+                posixRead.readMessages(fds[0], {}, (err, messages) => {
+                    if (err)
+                        return done(err);
+
+                    assert.deepStrictEqual(messages.map(String), ['world!']);
+                    done();
+                });
+            });
+        });
+
+        it('should wait for a message, then take those queued', (done) => {
+            posixRead.readMessages(fds[0], { maxMessages: 10 },
+                                   (err, messages) => {
+                if (err)
+                    return done(err);
+
+                assert.deepStrictEqual(messages.map(String),
+                                       ['a', 'bb', 'ccc']);
+                done();
+            });
+            setTimeout(() => {
+                fs.writeSync(fds[1], new Buffer('a'));
+                fs.writeSync(fds[1], new Buffer('bb'));
+                fs.writeSync(fds[1], new Buffer('ccc'));
+            }, 20);
+        });
+
+        it('should stop at maxBytes and leave the rest', (done) => {
+            ['1234', '5678', '9abc'].forEach((message) => {
+                fs.writeSync(fds[1], new Buffer(message));
+            });
+
+            posixRead.readMessages(fds[0], { maxMessages: 10, maxBytes: 10 },
+                                   (err, messages) => {
+                if (err)
+                    return done(err);
+
+                assert.deepStrictEqual(messages.map(String),
+                                       ['1234', '5678']);
+                posixRead.readMessages(fds[0], { maxBytes: 3 }, (err) => {
+                    assert(err);
+                    assert.strictEqual(err.frameTooLarge, true);
+
+                    posixRead.readMessages(fds[0], {}, (err, messages) => {
+                        if (err)
+                            return done(err);
+
+                        assert.deepStrictEqual(messages.map(String),
+                                               ['9abc']);
+                        done();
+                    });
+                });
+            });
+        });
+
+        it('should detect end of stream', (done) => {
+            fs.writeSync(fds[1], new Buffer('last'));
+            fs.closeSync(fds[1]);
+
+            posixRead.readMessages(fds[0], { maxMessages: 10 },
+                                   (err, messages) => {
+                if (err)
+                    return done(err);
+
+                assert.deepStrictEqual(messages.map(String), ['last']);
+                posixRead.readMessages(fds[0], {}, (err) => {
+                    assert(err);
+                    assert.strictEqual(err.endOfFile, true);
+                    done();
+                });
+            });
+        });
+
+        it('should copy messages to the capture file', (done) => {
+            const file = path.join(os.tmpdir(),
+                                   `posix-read-test-${process.pid}-msgcap`);
+            const captureFd = fs.openSync(file, 'w');
+            posixRead.startCapture(captureFd, {});
+            fs.writeSync(fds[1], new Buffer('captured'));
+
+            posixRead.readMessages(fds[0], {}, (err) => {
+                if (err)
+                    return done(err);
+
+                posixRead.stopCapture(() => {
+                    fs.closeSync(captureFd);
+                    const capture = fs.readFileSync(file);
+                    fs.unlinkSync(file);
+                    assert.strictEqual(capture.readUInt32LE(20), 8);
+                    assert.strictEqual(capture.toString('ascii', 24),
+                                       'captured');
+                    done();
+                });
+            });
+        });
+    });
+});
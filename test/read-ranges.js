@@ -0,0 +1,102 @@
+const assert = require('assert');
+const crypto = require('crypto');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const posixRead = require('../index');
+
+describe('posixRead.readRanges()', () => {
+    const file = path.join(os.tmpdir(), `posix-read-test-${process.pid}`);
+    const content = crypto.randomBytes(100000);
+    fs.writeFileSync(file, content);
+    const fd = fs.openSync(file, 'r');
+
+    after(() => {
+        fs.closeSync(fd);
+        fs.unlinkSync(file);
+    });
+
+    it('should detect bad file descriptor', (done) => {
+        try {
+            posixRead.readRanges('fd', [[0, 10]], () => {});
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'first argument should be a file ' +
+                                       'descriptor')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should detect bad ranges', (done) => {
+        try {
+            posixRead.readRanges(fd, [[0, 10], [-1, 10]], () => {});
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'second argument should be an array ' +
+                                       'of [offset, length] pairs')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should read disjoint ranges', (done) => {
+        const ranges = [[50000, 10], [0, 100], [99990, 10]];
+        posixRead.readRanges(fd, ranges, (err, views) => {
+            if (err)
+                return done(err);
+
+            assert.strictEqual(views.length, 3);
+            ranges.forEach((range, i) => {
+                assert.deepStrictEqual(
+                    views[i], content.slice(range[0], range[0] + range[1]));
+            });
+            done();
+        });
+    });
+
+    it('should coalesce adjacent and overlapping ranges', (done) => {
+        const ranges = [[1000, 100], [1100, 50], [1050, 200], [1060, 10]];
+        posixRead.readRanges(fd, ranges, (err, views) => {
+            if (err)
+                return done(err);
+
+            ranges.forEach((range, i) => {
+                assert.deepStrictEqual(
+                    views[i], content.slice(range[0], range[0] + range[1]));
+            });
+            // All views share a single buffer of 250 bytes
+            assert.strictEqual(views[0].buffer, views[3].buffer);
+            assert.strictEqual(views[0].buffer.byteLength, 250);
+            done();
+        });
+    });
+
+    it('should detect end of file', (done) => {
+        posixRead.readRanges(fd, [[99995, 10]], (err) => {
+            if (!err)
+                return done(new Error('error not thrown'));
+            if (err.endOfFile !== true
+                    || err.message !== 'reached end of file (at offset ' +
+                                       '100000)')
+                return done(err);
+            done();
+        });
+    });
+
+    it('should refuse ranges that do not fit in a buffer together', (done) => {
+        const max = require('buffer').kMaxLength;
+        try {
+            posixRead.readRanges(fd, [[0, max], [max + 1, max]], () => {});
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof RangeError
+                    && err.message === 'ranges would not fit in a buffer')
+                return done();
+            return done(err);
+        }
+    });
+});
@@ -0,0 +1,104 @@
+const assert = require('assert');
+const crypto = require('crypto');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.readRecords()', () => {
+    it('should detect bad first argument', (done) => {
+        try {
+            posixRead.readRecords('fd', 8, 10, () => {});
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'first argument should be a socket ' +
+                                       'or a file descriptor')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should read all whole records available', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            const data = crypto.randomBytes(83);
+            otherEnd.write(data, () => {
+                posixRead.readRecords(socket, 8, 100, (err, records) => {
+                    if (err)
+                        return done(err);
+
+                    assert.strictEqual(records.length, 10);
+                    records.forEach((record, i) => {
+                        assert.deepStrictEqual(
+                            record, data.slice(i * 8, (i + 1) * 8));
+                    });
+
+                    // The partial record must stay in the socket
+                    posixRead(socket, 3, (err, buffer) => {
+                        if (err)
+                            return done(err);
+
+                        assert.deepStrictEqual(buffer, data.slice(80));
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should read at most count records', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write('AAAABBBBCCCCDDDD', () => {
+                posixRead.readRecords(socket, 4, 2, (err, records) => {
+                    if (err)
+                        return done(err);
+
+                    assert.deepStrictEqual(
+                        records, [new Buffer('AAAA'), new Buffer('BBBB')]);
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should wait for a whole record', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead.readRecords(socket, 10, 5, (err, records) => {
+                if (err)
+                    return done(err);
+
+                assert.deepStrictEqual(records, [new Buffer('0123456789')]);
+                done();
+            });
+            otherEnd.write('01234');
+            setTimeout(() => {
+                otherEnd.write('56789');
+            }, 10);
+        });
+    });
+
+    it('should not consume a partial record of a file', (done) => {
+        const file = path.join(os.tmpdir(),
+                               `posix-read-test-${process.pid}-rec`);
+        fs.writeFileSync(file, crypto.randomBytes(100));
+        const fd = fs.openSync(file, 'r');
+
+        posixRead.readRecords(fd, 30, 10, (err, records) => {
+            if (err)
+                return done(err);
+
+            assert.strictEqual(records.length, 3);
+
+            posixRead.readRecords(fd, 30, 10, (err) => {
+                fs.closeSync(fd);
+                fs.unlinkSync(file);
+
+                if (!err || err.endOfFile !== true)
+                    return done(err || new Error('error not thrown'));
+                done();
+            });
+        });
+    });
+});
@@ -0,0 +1,83 @@
+const assert = require('assert');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.readUInt*()', () => {
+    it('should detect bad endianness', (done) => {
+        getNewSocket(function onSocket(socket) {
+            try {
+                posixRead.readUInt16(socket, 'XE', () => {});
+                done(new Error('error not thrown'));
+            } catch (err) {
+                if (err instanceof TypeError
+                        && err.message === 'second argument should be ' +
+                                           "'BE' or 'LE'")
+                    return done();
+                return done(err);
+            }
+        });
+    });
+
+    it('should read integers of all widths', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            const data = new Buffer([0x2a,
+                                     0x12, 0x34,
+                                     0x12, 0x34,
+                                     0xde, 0xad, 0xbe, 0xef,
+                                     0xde, 0xad, 0xbe, 0xef]);
+            otherEnd.write(data, () => {
+                posixRead.readUInt8(socket, 'BE', (err, a) => {
+                    assert.ifError(err);
+                    assert.strictEqual(a, 0x2a);
+                    posixRead.readUInt16(socket, 'BE', (err, b) => {
+                        assert.ifError(err);
+                        assert.strictEqual(b, 0x1234);
+                        posixRead.readUInt16(socket, 'LE', (err, c) => {
+                            assert.ifError(err);
+                            assert.strictEqual(c, 0x3412);
+                            posixRead.readUInt32(socket, 'BE', (err, d) => {
+                                assert.ifError(err);
+                                assert.strictEqual(d, 0xdeadbeef);
+                                posixRead.readUInt32(socket, 'LE', (err, e) => {
+                                    assert.ifError(err);
+                                    assert.strictEqual(e, 0xefbeadde);
+                                    done();
+                                });
+                            });
+                        });
+                    });
+                });
+            });
+        });
+    });
+
+    if (posixRead.readBigUInt64)
+        it('should read 64-bit integers as BigInt', (done) => {
+            getNewSocket(function onSocket(socket, otherEnd) {
+                const data = new Buffer([1, 0, 0, 0, 0, 0, 0, 2]);
+                otherEnd.write(data, () => {
+                    posixRead.readBigUInt64(socket, 'BE', (err, value) => {
+                        if (err)
+                            return done(err);
+
+                        assert.strictEqual(value.toString(16),
+                                           '100000000000002');
+                        done();
+                    });
+                });
+            });
+        });
+
+    it('should detect end of stream', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.end('ab', () => {
+                posixRead.readUInt32(socket, 'BE', (err) => {
+                    if (!err || err.endOfFile !== true)
+                        return done(err || new Error('error not thrown'));
+                    done();
+                });
+            });
+        });
+    });
+});
@@ -0,0 +1,95 @@
+const assert = require('assert');
+const crypto = require('crypto');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+/*
+ * Build a masked frame, as sent by a client.
+ */
+function frameHeader(opcode, length) {
+    if (length < 126)
+        return new Buffer([0x80 | opcode, 0x80 | length]);
+
+    const header = new Buffer(length < 65536 ? 4 : 10).fill(0);
+    header[0] = 0x80 | opcode;
+    if (length < 65536) {
+        header[1] = 0x80 | 126;
+        header.writeUInt16BE(length, 2);
+    } else {
+        header[1] = 0x80 | 127;
+        header.writeUInt32BE(length, 6);
+    }
+    return header;
+}
+
+function maskedFrame(opcode, payload) {
+    const mask = crypto.randomBytes(4);
+    const masked = new Buffer(payload.map((byte, i) => byte ^ mask[i % 4]));
+    return Buffer.concat([frameHeader(opcode, payload.length), mask, masked]);
+}
+
+describe('posixRead.readWebSocketFrame()', () => {
+    it('should detect bad second argument', (done) => {
+        getNewSocket(function onSocket(socket) {
+            try {
+                posixRead.readWebSocketFrame(socket, 16, () => {});
+                done(new Error('error not thrown'));
+            } catch (err) {
+                if (err instanceof TypeError
+                        && err.message === 'second argument should be an ' +
+                                           'object with valid options')
+                    return done();
+                return done(err);
+            }
+        });
+    });
+
+    [5, 300, 70000].forEach((size) => {
+        it(`should read and unmask a ${size}-byte frame`, (done) => {
+            getNewSocket(function onSocket(socket, otherEnd) {
+                const payload = crypto.randomBytes(size);
+                otherEnd.write(Buffer.concat([maskedFrame(2, payload),
+                                              new Buffer('next')]));
+
+                posixRead.readWebSocketFrame(socket, {}, (err, frame) => {
+                    if (err)
+                        return done(err);
+
+                    assert.strictEqual(frame.fin, true);
+                    assert.strictEqual(frame.opcode, 2);
+                    assert.strictEqual(frame.masked, true);
+                    assert.deepStrictEqual(frame.payload, payload);
+
+                    // The next frame must stay in the socket
+                    posixRead(socket, 4, (err, buffer) => {
+                        if (err)
+                            return done(err);
+
+                        assert.strictEqual(buffer.toString(), 'next');
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should leave frames larger than maxBytes in the socket', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write(maskedFrame(1, new Buffer(200)), () => {
+                posixRead.readWebSocketFrame(socket, { maxBytes: 100 },
+                                             (err) => {
+                    assert.strictEqual(err.frameTooLarge, true);
+
+                    posixRead(socket, 1, (err, buffer) => {
+                        if (err)
+                            return done(err);
+
+                        assert.strictEqual(buffer[0], 0x81);
+                        done();
+                    });
+                });
+            });
+        });
+    });
+});
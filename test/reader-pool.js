@@ -0,0 +1,100 @@
+const assert = require('assert');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.setReaderPool()', () => {
+    afterEach(() => {
+        posixRead.setReaderPool(null);
+    });
+
+    it('should detect bad first argument', (done) => {
+        try {
+            posixRead.setReaderPool({ minThreads: 4, maxThreads: 2 });
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'first argument should be an object ' +
+                                       'with valid options')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should read through the pool', (done) => {
+        posixRead.setReaderPool({ minThreads: 1, maxThreads: 4 });
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead(socket, 4, (err, buffer) => {
+                if (err)
+                    return done(err);
+
+                assert.strictEqual(buffer.toString(), 'abcd');
+                const stats = posixRead.readerPoolStats();
+                assert(stats.threads >= 1);
+                assert(stats.queueWaitMs.count >= 1);
+                assert.strictEqual(stats.queuedReads, 0);
+                done();
+            });
+            otherEnd.write('abcd');
+        });
+    });
+
+    it('should not use CPU when idle at minThreads', (done) => {
+        posixRead.setReaderPool({ minThreads: 1, maxThreads: 4, idleMs: 0 });
+        getNewSocket(function onSocket(socket, otherEnd) {
+            posixRead(socket, 1, (err) => {
+                if (err)
+                    return done(err);
+
+                // Past the idle deadline, the remaining thread must sleep.
+                setTimeout(() => {
+                    const before = process.cpuUsage();
+                    setTimeout(() => {
+                        const used = process.cpuUsage(before);
+                        assert.strictEqual(posixRead.readerPoolStats()
+                                               .threads, 1);
+                        assert(used.user + used.system < 100000);
+                        done();
+                    }, 300);
+                }, 50);
+            });
+            otherEnd.write('a');
+        });
+    });
+
+    it('should grow when all threads are blocked', (done) => {
+        const events = [];
+        posixRead.setReaderPool({
+            minThreads: 1,
+            maxThreads: 4,
+            onScale: (event, threads) => events.push([event, threads]),
+        });
+        getNewSocket(function onSocket(socket1, otherEnd1) {
+            getNewSocket(function onSocket(socket2, otherEnd2) {
+                const buffers = [];
+                function onRead(err, buffer) {
+                    if (err)
+                        return done(err);
+                    buffers.push(buffer);
+                    if (buffers.length < 2)
+                        return;
+
+                    assert(posixRead.readerPoolStats().grown >= 1);
+                    setImmediate(() => {
+                        assert(events.some((e) => e[0] === 'grow' &&
+                                                  e[1] >= 2));
+                        done();
+                    });
+                }
+
+                // Both reads block, so they need two threads.
+                posixRead(socket1, 1, onRead);
+                posixRead(socket2, 1, onRead);
+                setTimeout(() => {
+                    otherEnd1.write('a');
+                    otherEnd2.write('b');
+                }, 20);
+            });
+        });
+    });
+});
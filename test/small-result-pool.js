@@ -0,0 +1,61 @@
+const assert = require('assert');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+describe('posixRead.setSmallResultPool()', () => {
+    it('should detect bad first argument', (done) => {
+        try {
+            posixRead.setSmallResultPool({ maxSize: 100, slabSize: 10 });
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'first argument should be an object ' +
+                                       'with valid options')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should pack small results in a shared slab', (done) => {
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write('0123456789abcdef', () => {
+                posixRead(socket, 8, (err, first) => {
+                    if (err)
+                        return done(err);
+
+                    posixRead(socket, 8, (err, second) => {
+                        if (err)
+                            return done(err);
+
+                        assert.strictEqual(first.toString(), '01234567');
+                        assert.strictEqual(second.toString(), '89abcdef');
+                        assert.strictEqual(first.buffer, second.buffer);
+                        done();
+                    });
+                });
+            });
+        });
+    });
+
+    it('should not pool results when disabled', (done) => {
+        posixRead.setSmallResultPool({ maxSize: 0 });
+        getNewSocket(function onSocket(socket, otherEnd) {
+            otherEnd.write('0123456789abcdef', () => {
+                posixRead(socket, 8, (err, first) => {
+                    if (err)
+                        return done(err);
+
+                    posixRead(socket, 8, (err, second) => {
+                        posixRead.setSmallResultPool({ maxSize: 64 });
+                        if (err)
+                            return done(err);
+
+                        assert.notStrictEqual(first.buffer, second.buffer);
+                        done();
+                    });
+                });
+            });
+        });
+    });
+});
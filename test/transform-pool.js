@@ -0,0 +1,91 @@
+const assert = require('assert');
+const crypto = require('crypto');
+
+const posixRead = require('../index');
+const getNewSocket = require('./lib/sockets').getNewSocket;
+
+function maskedFrame(payload) {
+    const mask = crypto.randomBytes(4);
+    const header = new Buffer([0x82, 0x80 | 126, 0, 0]);
+    header.writeUInt16BE(payload.length, 2);
+    const masked = new Buffer(payload.map((byte, i) => byte ^ mask[i % 4]));
+    return Buffer.concat([header, mask, masked]);
+}
+
+describe('posixRead.setTransformPool()', () => {
+    afterEach(() => {
+        posixRead.setTransformPool(null);
+    });
+
+    it('should detect bad first argument', (done) => {
+        try {
+            posixRead.setTransformPool({ threads: -1 });
+            done(new Error('error not thrown'));
+        } catch (err) {
+            if (err instanceof TypeError
+                    && err.message === 'first argument should be an object ' +
+                                       'with valid options, or null')
+                return done();
+            return done(err);
+        }
+    });
+
+    it('should unmask in the transform pool', (done) => {
+        posixRead.setTransformPool({ threads: 2, minBytes: 1000 });
+        assert.strictEqual(posixRead.transformPoolStats().threads, 2);
+        const before = posixRead.transformPoolStats().transforms;
+
+        getNewSocket(function onSocket(socket, otherEnd) {
+            const payload = crypto.randomBytes(5000);
+            otherEnd.write(Buffer.concat([maskedFrame(payload),
+                                          new Buffer('next')]));
+
+            posixRead.readWebSocketFrame(socket, {}, (err, frame) => {
+                if (err)
+                    return done(err);
+
+                assert.deepStrictEqual(frame.payload, payload);
+                assert.strictEqual(posixRead.transformPoolStats().transforms,
+                                   before + 1);
+
+                posixRead(socket, 4, (err, buffer) => {
+                    if (err)
+                        return done(err);
+
+                    assert.strictEqual(buffer.toString(), 'next');
+                    done();
+                });
+            });
+        });
+    });
+
+    it('should read the next frame while transforming the previous one',
+       (done) => {
+        posixRead.setTransformPool({ threads: 1, minBytes: 1000 });
+        const before = posixRead.rateLimitStats().overlappedReads;
+
+        getNewSocket(function onSocket(socket, otherEnd) {
+            const payloads = [crypto.randomBytes(60000),
+                              crypto.randomBytes(100)];
+            otherEnd.write(Buffer.concat(payloads.map(maskedFrame)));
+
+            const received = [];
+            function onFrame(err, frame) {
+                if (err)
+                    return done(err);
+
+                received.push(frame.payload);
+                if (received.length < 2)
+                    return;
+
+                // In order, even if the second one had nothing to transform
+                assert.deepStrictEqual(received, payloads);
+                assert.strictEqual(posixRead.rateLimitStats().overlappedReads,
+                                   before + 1);
+                done();
+            }
+            posixRead.readWebSocketFrame(socket, {}, onFrame);
+            posixRead.readWebSocketFrame(socket, {}, onFrame);
+        });
+    });
+});